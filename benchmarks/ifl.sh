@@ -0,0 +1,69 @@
+#!/usr/bin/env bash
+set -e
+
+# compares ifl throughput when reading through a stream (--no-mmap)
+# against the default memory mapped read
+
+SIZE="1G"
+PINE="./build/release/pine"
+
+if [[ $# > 0 ]]; then
+  SIZE="$1"
+fi
+if [[ $# > 1 ]]; then
+  PINE="$2"
+fi
+
+if [[ ! -x ${PINE} ]]; then
+  printf "usage: ./benchmarks/ifl.sh [size] [pine_binary]\n"
+  printf "error: '${PINE}' is not executable, build with ./build.sh -r\n"
+  exit 1
+fi
+PINE="$(cd "$(dirname "${PINE}")" && pwd)/$(basename "${PINE}")"
+
+DIR="$(mktemp -d)"
+trap 'rm -rf "${DIR}"' EXIT
+cd "${DIR}"
+
+printf "generating ${SIZE} input file\n"
+yes "the quick brown fox jumps over the lazy pine" | head -c "${SIZE}" > data
+BYTES=$(stat -c %s data)
+
+# warm the page cache so both modes measure the interpreter, not the disk
+cat data > /dev/null
+
+cat > read.pn <<'PN'
+mov d ''
+mov f 'data'
+ifl d f
+mov ec 0
+ext ec
+PN
+
+cat > touch.pn <<'PN'
+mov d ''
+mov f 'data'
+mov o 'copy'
+ifl d f
+ofl d o
+mov ec 0
+ext ec
+PN
+
+bench()
+{
+  local name="$1"
+  shift
+  local start end
+  start=$(date +%s.%N)
+  "${PINE}" "$@" > /dev/null
+  end=$(date +%s.%N)
+  awk -v n="${name}" -v s="${start}" -v e="${end}" -v b="${BYTES}" \
+    'BEGIN { t = e - s; printf "%-16s %10.3f s %12.1f MB/s\n", n, t, b / t / 1000000 }'
+}
+
+printf "\n%-16s %12s %17s\n" "mode" "time" "throughput"
+bench "read stream" --no-mmap -f read.pn
+bench "read mmap" -f read.pn
+bench "touch stream" --no-mmap -f touch.pn
+bench "touch mmap" -f touch.pn
@@ -0,0 +1,496 @@
+#include "aio.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace OB
+{
+  namespace
+  {
+    // upper bound of a single read or write submission
+    constexpr std::size_t chunk_size {1UL << 30};
+
+    // number of submission queue entries
+    constexpr unsigned ring_entries {64};
+
+    // number of threads used by the fallback backend
+    constexpr std::size_t pool_size {4};
+
+    int io_uring_setup(unsigned entries, io_uring_params* params)
+    {
+      return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+      return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+        flags, nullptr, 0));
+    }
+
+    unsigned* ring_ptr(void* base, unsigned offset)
+    {
+      return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+    }
+  } // namespace
+
+  Aio::Aio(Backend const backend) :
+    backend_ {backend}
+  {
+    if (backend_ == Backend::uring && ! ring_setup())
+    {
+      backend_ = Backend::threads;
+    }
+  }
+
+  Aio::~Aio()
+  {
+    wait();
+
+    if (backend_ == Backend::uring)
+    {
+      ring_teardown();
+    }
+    else
+    {
+      {
+        std::lock_guard<std::mutex> lock {mtx_};
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto& e : workers_)
+      {
+        e.join();
+      }
+    }
+  }
+
+  Aio::Backend Aio::backend() const
+  {
+    return backend_;
+  }
+
+  std::shared_ptr<Aio::Op> Aio::read(std::string const& path)
+  {
+    int fd {::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd < 0)
+    {
+      return nullptr;
+    }
+
+    // special files have no size to read up front
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || ! S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+      ::close(fd);
+      return nullptr;
+    }
+
+    auto op = std::make_shared<Op>();
+    op->path = path;
+    op->fd = fd;
+    op->data.resize(static_cast<std::size_t>(st.st_size));
+    submit(op);
+
+    return op;
+  }
+
+  std::shared_ptr<Aio::Op> Aio::write(std::string const& path, std::string data, bool const append)
+  {
+    int fd {::open(path.c_str(),
+      O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666)};
+    if (fd < 0)
+    {
+      return nullptr;
+    }
+
+    auto op = std::make_shared<Op>();
+    op->path = path;
+    op->write = true;
+    op->fd = fd;
+    op->data = std::move(data);
+
+    if (op->data.empty())
+    {
+      finish(*op);
+      return op;
+    }
+
+    submit(op);
+
+    return op;
+  }
+
+  bool Aio::wait(Op& op)
+  {
+    if (backend_ == Backend::uring)
+    {
+      while (! op.complete)
+      {
+        ring_reap(true);
+      }
+    }
+    else
+    {
+      std::unique_lock<std::mutex> lock {mtx_};
+      cv_done_.wait(lock, [&] { return op.complete; });
+    }
+
+    inflight_.erase(std::remove_if(inflight_.begin(), inflight_.end(),
+      [&](std::shared_ptr<Op> const& e) { return e.get() == &op; }), inflight_.end());
+
+    return op.err == 0;
+  }
+
+  void Aio::wait(std::string const& path)
+  {
+    auto const ops = inflight_;
+    for (auto const& e : ops)
+    {
+      if (e->path == path)
+      {
+        wait(*e);
+      }
+    }
+  }
+
+  void Aio::wait()
+  {
+    auto const ops = inflight_;
+    for (auto const& e : ops)
+    {
+      wait(*e);
+    }
+  }
+
+  void Aio::submit(std::shared_ptr<Op> op)
+  {
+    inflight_.emplace_back(op);
+
+    if (backend_ == Backend::uring)
+    {
+      // keep the completion queue from overflowing
+      while (ring_queued_ >= ring_.entries)
+      {
+        ring_reap(true);
+      }
+      ring_submit(*op);
+      return;
+    }
+
+    pool_start();
+    {
+      std::lock_guard<std::mutex> lock {mtx_};
+      queue_.emplace_back(std::move(op));
+    }
+    cv_.notify_one();
+  }
+
+  void Aio::finish(Op& op)
+  {
+    if (! op.write && op.done < op.data.size())
+    {
+      // the file shrank while it was being read
+      op.data.resize(op.done);
+    }
+    if (op.fd >= 0)
+    {
+      ::close(op.fd);
+      op.fd = -1;
+    }
+    op.complete = true;
+  }
+
+  bool Aio::ring_setup()
+  {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    int fd {io_uring_setup(ring_entries, &params)};
+    if (fd < 0)
+    {
+      return false;
+    }
+    ring_.fd = fd;
+    ring_.entries = params.sq_entries;
+
+    ring_.sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring_.cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool const single {(params.features & IORING_FEAT_SINGLE_MMAP) != 0};
+    if (single)
+    {
+      ring_.sq_len = ring_.cq_len = std::max(ring_.sq_len, ring_.cq_len);
+    }
+
+    ring_.sq_ptr = ::mmap(nullptr, ring_.sq_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring_.sq_ptr == MAP_FAILED)
+    {
+      ring_.sq_ptr = nullptr;
+      ring_teardown();
+      return false;
+    }
+
+    if (single)
+    {
+      ring_.cq_ptr = ring_.sq_ptr;
+    }
+    else
+    {
+      ring_.cq_ptr = ::mmap(nullptr, ring_.cq_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (ring_.cq_ptr == MAP_FAILED)
+      {
+        ring_.cq_ptr = nullptr;
+        ring_teardown();
+        return false;
+      }
+    }
+
+    ring_.sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes {::mmap(nullptr, ring_.sqes_len, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES)};
+    if (sqes == MAP_FAILED)
+    {
+      ring_teardown();
+      return false;
+    }
+    ring_.sqes = static_cast<io_uring_sqe*>(sqes);
+
+    ring_.sq_head = ring_ptr(ring_.sq_ptr, params.sq_off.head);
+    ring_.sq_tail = ring_ptr(ring_.sq_ptr, params.sq_off.tail);
+    ring_.sq_mask = ring_ptr(ring_.sq_ptr, params.sq_off.ring_mask);
+    ring_.sq_array = ring_ptr(ring_.sq_ptr, params.sq_off.array);
+
+    ring_.cq_head = ring_ptr(ring_.cq_ptr, params.cq_off.head);
+    ring_.cq_tail = ring_ptr(ring_.cq_ptr, params.cq_off.tail);
+    ring_.cq_mask = ring_ptr(ring_.cq_ptr, params.cq_off.ring_mask);
+    ring_.cqes = reinterpret_cast<io_uring_cqe*>(
+      static_cast<char*>(ring_.cq_ptr) + params.cq_off.cqes);
+
+    return true;
+  }
+
+  void Aio::ring_teardown()
+  {
+    if (ring_.sqes != nullptr)
+    {
+      ::munmap(ring_.sqes, ring_.sqes_len);
+    }
+    if (ring_.cq_ptr != nullptr && ring_.cq_ptr != ring_.sq_ptr)
+    {
+      ::munmap(ring_.cq_ptr, ring_.cq_len);
+    }
+    if (ring_.sq_ptr != nullptr)
+    {
+      ::munmap(ring_.sq_ptr, ring_.sq_len);
+    }
+    if (ring_.fd >= 0)
+    {
+      ::close(ring_.fd);
+    }
+    ring_ = Ring {};
+  }
+
+  void Aio::ring_submit(Op& op)
+  {
+    ring_queue(op);
+    ring_flush();
+  }
+
+  void Aio::ring_queue(Op& op)
+  {
+    std::size_t const len {std::min(op.data.size() - op.done, chunk_size)};
+    op.iov.iov_base = &op.data[op.done];
+    op.iov.iov_len = len;
+
+    // single producer, only the kernel moves the head
+    unsigned const tail {*ring_.sq_tail};
+    unsigned const index {tail & *ring_.sq_mask};
+
+    auto& sqe = ring_.sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = op.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = op.fd;
+    sqe.off = op.done;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&op.iov);
+    sqe.len = 1;
+    sqe.user_data = reinterpret_cast<std::uint64_t>(&op);
+
+    ring_.sq_array[index] = index;
+    __atomic_store_n(ring_.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++ring_queued_;
+    ++ring_unsubmitted_;
+  }
+
+  void Aio::ring_flush()
+  {
+    while (ring_unsubmitted_ > 0)
+    {
+      int const n {io_uring_enter(ring_.fd, ring_unsubmitted_, 0, 0)};
+      if (n > 0)
+      {
+        ring_unsubmitted_ -= std::min(ring_unsubmitted_, static_cast<unsigned>(n));
+        continue;
+      }
+      if (n == 0 || errno == EAGAIN || errno == EBUSY)
+      {
+        // make room by taking completions, ops with bytes left are queued
+        // behind the entries already waiting, blocks only while some
+        // submitted op can still complete
+        ring_complete(ring_queued_ > ring_unsubmitted_);
+        continue;
+      }
+      if (errno != EINTR)
+      {
+        // the entries were never consumed, fail their ops in place
+        int const err {errno};
+        unsigned tail {*ring_.sq_tail};
+        while (ring_unsubmitted_ > 0)
+        {
+          --tail;
+          --ring_unsubmitted_;
+          --ring_queued_;
+          auto& op = *reinterpret_cast<Op*>(ring_.sqes[tail & *ring_.sq_mask].user_data);
+          op.err = err;
+          finish(op);
+        }
+        __atomic_store_n(ring_.sq_tail, tail, __ATOMIC_RELEASE);
+        return;
+      }
+    }
+  }
+
+  void Aio::ring_reap(bool const block)
+  {
+    ring_complete(block);
+    ring_flush();
+  }
+
+  void Aio::ring_complete(bool const block)
+  {
+    unsigned head {*ring_.cq_head};
+    if (block && head == __atomic_load_n(ring_.cq_tail, __ATOMIC_ACQUIRE))
+    {
+      io_uring_enter(ring_.fd, 0, 1, IORING_ENTER_GETEVENTS);
+    }
+
+    while (head != __atomic_load_n(ring_.cq_tail, __ATOMIC_ACQUIRE))
+    {
+      auto const& cqe = ring_.cqes[head & *ring_.cq_mask];
+      auto& op = *reinterpret_cast<Op*>(cqe.user_data);
+      int const res {cqe.res};
+
+      ++head;
+      __atomic_store_n(ring_.cq_head, head, __ATOMIC_RELEASE);
+      --ring_queued_;
+
+      // an op with bytes left is only queued here, the caller submits it
+      // once the completion queue is no longer being walked
+      if (res == -EINTR || res == -EAGAIN)
+      {
+        ring_queue(op);
+      }
+      else if (res < 0)
+      {
+        op.err = -res;
+        finish(op);
+      }
+      else if (res == 0)
+      {
+        // end of file on a read, nothing written on a write
+        if (op.write)
+        {
+          op.err = EIO;
+        }
+        finish(op);
+      }
+      else
+      {
+        op.done += static_cast<std::size_t>(res);
+        if (op.done < op.data.size())
+        {
+          ring_queue(op);
+        }
+        else
+        {
+          finish(op);
+        }
+      }
+    }
+  }
+
+  void Aio::pool_start()
+  {
+    if (! workers_.empty())
+    {
+      return;
+    }
+
+    for (std::size_t i = 0; i < pool_size; ++i)
+    {
+      workers_.emplace_back([this] { pool_worker(); });
+    }
+  }
+
+  void Aio::pool_worker()
+  {
+    for (;;)
+    {
+      std::shared_ptr<Op> op;
+      {
+        std::unique_lock<std::mutex> lock {mtx_};
+        cv_.wait(lock, [&] { return stop_ || ! queue_.empty(); });
+        if (queue_.empty())
+        {
+          return;
+        }
+        op = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      int err {0};
+      while (op->done < op->data.size())
+      {
+        std::size_t const len {std::min(op->data.size() - op->done, chunk_size)};
+        auto const off = static_cast<off_t>(op->done);
+        auto const n = op->write ?
+          ::pwrite(op->fd, op->data.data() + op->done, len, off) :
+          ::pread(op->fd, &op->data[op->done], len, off);
+        if (n < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+          err = errno;
+          break;
+        }
+        if (n == 0)
+        {
+          if (op->write)
+          {
+            err = EIO;
+          }
+          break;
+        }
+        op->done += static_cast<std::size_t>(n);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock {mtx_};
+        op->err = err;
+        finish(*op);
+      }
+      cv_done_.notify_all();
+    }
+  }
+} // namespace OB
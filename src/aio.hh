@@ -0,0 +1,140 @@
+#ifndef OB_AIO_HH
+#define OB_AIO_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace OB
+{
+class Aio
+{
+public:
+  enum class Backend
+  {
+    uring,
+    threads,
+  };
+
+  struct Op
+  {
+    std::string path;
+    bool write {false};
+
+    // read destination or write source
+    std::string data;
+    std::size_t done {0};
+
+    // errno of the first failed read or write
+    int err {0};
+    bool complete {false};
+
+    int fd {-1};
+    iovec iov {};
+  };
+
+  // falls back to the thread pool if io_uring is unavailable
+  Aio(Backend const backend = Backend::uring);
+
+  // blocks until every queued operation has completed
+  ~Aio();
+
+  Aio(Aio const&) = delete;
+  Aio& operator=(Aio const&) = delete;
+
+  Backend backend() const;
+
+  // opens the file and queues a read of its whole content
+  // returns nullptr if it is not a regular file that can be opened
+  std::shared_ptr<Op> read(std::string const& path);
+
+  // opens the file and queues a write of data
+  // returns nullptr if the file can not be opened
+  std::shared_ptr<Op> write(std::string const& path, std::string data, bool const append);
+
+  // blocks until op has completed, returns false on an io error
+  bool wait(Op& op);
+
+  // blocks until every queued operation on path has completed
+  void wait(std::string const& path);
+
+  // blocks until every queued operation has completed
+  void wait();
+
+private:
+  struct Ring
+  {
+    int fd {-1};
+    unsigned entries {0};
+
+    unsigned* sq_head {nullptr};
+    unsigned* sq_tail {nullptr};
+    unsigned* sq_mask {nullptr};
+    unsigned* sq_array {nullptr};
+    io_uring_sqe* sqes {nullptr};
+
+    unsigned* cq_head {nullptr};
+    unsigned* cq_tail {nullptr};
+    unsigned* cq_mask {nullptr};
+    io_uring_cqe* cqes {nullptr};
+
+    void* sq_ptr {nullptr};
+    std::size_t sq_len {0};
+    void* cq_ptr {nullptr};
+    std::size_t cq_len {0};
+    std::size_t sqes_len {0};
+  };
+
+  void submit(std::shared_ptr<Op> op);
+  void finish(Op& op);
+
+  // io_uring
+  bool ring_setup();
+  void ring_teardown();
+  void ring_submit(Op& op);
+  void ring_reap(bool const block);
+
+  // adds an entry for op without entering the kernel
+  void ring_queue(Op& op);
+
+  // hands the queued entries to the kernel, taking completions while
+  // the rings are full
+  void ring_flush();
+
+  // walks the completion queue, ops with bytes left are queued again
+  // but not submitted
+  void ring_complete(bool const block);
+
+  // thread pool
+  void pool_start();
+  void pool_worker();
+
+  Backend backend_;
+  std::vector<std::shared_ptr<Op>> inflight_;
+
+  Ring ring_;
+  unsigned ring_queued_ {0};
+  unsigned ring_unsubmitted_ {0};
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::condition_variable cv_done_;
+  std::deque<std::shared_ptr<Op>> queue_;
+  std::vector<std::thread> workers_;
+  bool stop_ {false};
+}; // class Aio
+
+} // namespace OB
+
+#endif // OB_AIO_HH
@@ -0,0 +1,41 @@
+#include "alloc.hh"
+
+#include <atomic>
+
+namespace OB
+{
+namespace Alloc
+{
+  namespace
+  {
+    std::atomic<bool> on_ {false};
+    std::atomic<std::uint64_t> bytes_ {0};
+    std::atomic<std::uint64_t> count_ {0};
+  } // namespace
+
+  void enable()
+  {
+    on_.store(true, std::memory_order_relaxed);
+  }
+
+  void record(std::size_t const size)
+  {
+    if (on_.load(std::memory_order_relaxed))
+    {
+      bytes_.fetch_add(size, std::memory_order_relaxed);
+      count_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::uint64_t bytes()
+  {
+    return bytes_.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t count()
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+} // namespace Alloc
+
+} // namespace OB
@@ -0,0 +1,28 @@
+#ifndef OB_ALLOC_HH
+#define OB_ALLOC_HH
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+namespace Alloc
+{
+  // starts counting, until then record only checks a flag
+  void enable();
+
+  // counts one allocation of size bytes once enabled, called by the
+  // operator new of alloc_new.cc, which only the pine executable links,
+  // without it the counters stay at zero
+  void record(std::size_t const size);
+
+  // total bytes requested through operator new by the process
+  std::uint64_t bytes();
+
+  // number of calls to operator new by the process
+  std::uint64_t count();
+} // namespace Alloc
+
+} // namespace OB
+
+#endif // OB_ALLOC_HH
@@ -0,0 +1,61 @@
+#include "alloc.hh"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  void* allocate(std::size_t size)
+  {
+    OB::Alloc::record(size);
+
+    for (;;)
+    {
+      void* ptr {std::malloc(size == 0 ? 1 : size)};
+      if (ptr != nullptr)
+      {
+        return ptr;
+      }
+      auto const handler = std::get_new_handler();
+      if (handler == nullptr)
+      {
+        throw std::bad_alloc();
+      }
+      handler();
+    }
+  }
+} // namespace
+
+// replacing the global allocation functions counts every allocation once
+// enabled, including the ones made inside the standard library,
+// only linked into the pine executable so that a program embedding
+// pine-core keeps its own allocator
+void* operator new(std::size_t size)
+{
+  return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+  return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
@@ -0,0 +1,398 @@
+#include "array.hh"
+
+#include "conv.hh"
+#include "simd.hh"
+
+namespace OB
+{
+  namespace
+  {
+    // adds val to sum wrapping around and counts the wraps up and down,
+    // the exact sum fit when the count ends at zero
+    void add_wrapped(std::int64_t& sum, std::int64_t const val, std::int64_t& wraps)
+    {
+      if (__builtin_add_overflow(sum, val, &sum))
+      {
+        wraps += val > 0 ? 1 : -1;
+      }
+    }
+  } // namespace
+
+  Array::Array(Type const type, std::size_t const size) :
+    type_ {type}
+  {
+    switch (type_)
+    {
+      case Type::integer:
+        ints_.resize(size, 0);
+        break;
+
+      case Type::real:
+        dbls_.resize(size, 0.0);
+        break;
+
+      default:
+        strs_.resize(size);
+        break;
+    }
+  }
+
+  Array::Array(std::shared_ptr<Mmap const> fmap) :
+    type_ {Type::string},
+    fmap_ {std::move(fmap)}
+  {
+  }
+
+  void Array::append_view(std::size_t const off, std::size_t const len)
+  {
+    spans_.emplace_back(off, len);
+  }
+
+  bool Array::view(std::size_t const index, std::shared_ptr<Mmap const>& fmap,
+    std::size_t& off, std::size_t& len) const
+  {
+    if (! fmap_)
+    {
+      return false;
+    }
+    fmap = fmap_;
+    off = spans_.at(index).first;
+    len = spans_.at(index).second;
+    return true;
+  }
+
+  void Array::own()
+  {
+    if (! fmap_)
+    {
+      return;
+    }
+    strs_.reserve(spans_.size());
+    for (auto const& e : spans_)
+    {
+      strs_.emplace_back(fmap_->data() + e.first, e.second);
+    }
+    spans_.clear();
+    spans_.shrink_to_fit();
+    fmap_.reset();
+  }
+
+  Array::Type Array::type() const
+  {
+    return type_;
+  }
+
+  std::size_t Array::size() const
+  {
+    switch (type_)
+    {
+      case Type::integer:
+        return ints_.size();
+
+      case Type::real:
+        return dbls_.size();
+
+      default:
+        return fmap_ ? spans_.size() : strs_.size();
+    }
+  }
+
+  char const* Array::value_type() const
+  {
+    switch (type_)
+    {
+      case Type::integer:
+        return "int";
+
+      case Type::real:
+        return "dbl";
+
+      default:
+        return "str";
+    }
+  }
+
+  std::string Array::get(std::size_t const index) const
+  {
+    switch (type_)
+    {
+      case Type::integer:
+      {
+        std::string res;
+        Conv::set_int(res, ints_.at(index));
+        return res;
+      }
+
+      case Type::real:
+      {
+        std::string res;
+        Conv::set_dbl(res, dbls_.at(index));
+        return res;
+      }
+
+      default:
+      {
+        if (fmap_)
+        {
+          auto const& e = spans_.at(index);
+          return std::string(fmap_->data() + e.first, e.second);
+        }
+        return strs_.at(index);
+      }
+    }
+  }
+
+  bool Array::set(std::size_t const index, std::string const& val)
+  {
+    switch (type_)
+    {
+      case Type::integer:
+        return Conv::parse(val, ints_.at(index)) == Conv::Error::none;
+
+      case Type::real:
+        return Conv::parse(val, dbls_.at(index)) == Conv::Error::none;
+
+      default:
+        own();
+        strs_.at(index) = val;
+        return true;
+    }
+  }
+
+  bool Array::append(std::string const& val)
+  {
+    switch (type_)
+    {
+      case Type::integer:
+      {
+        std::int64_t num {0};
+        if (Conv::parse(val, num) != Conv::Error::none)
+        {
+          return false;
+        }
+        ints_.emplace_back(num);
+        return true;
+      }
+
+      case Type::real:
+      {
+        double num {0};
+        if (Conv::parse(val, num) != Conv::Error::none)
+        {
+          return false;
+        }
+        dbls_.emplace_back(num);
+        return true;
+      }
+
+      default:
+        own();
+        strs_.emplace_back(val);
+        return true;
+    }
+  }
+
+  bool Array::combine(Op const op, Array const& rhs)
+  {
+    if (type_ == Type::integer)
+    {
+      auto const n = ints_.size();
+      auto const lhs = ints_.data();
+      auto const val = rhs.ints_.data();
+
+      switch (op)
+      {
+        case Op::add:
+          Simd::add(lhs, val, n);
+          break;
+
+        case Op::sub:
+          Simd::sub(lhs, val, n);
+          break;
+
+        case Op::mlt:
+          Simd::mlt(lhs, val, n);
+          break;
+
+        case Op::min:
+          Simd::min(lhs, val, n);
+          break;
+
+        case Op::max:
+          Simd::max(lhs, val, n);
+          break;
+
+        default:
+        {
+          // no vector int division, checked before anything is written
+          for (std::size_t i = 0; i < n; ++i)
+          {
+            if (val[i] == 0)
+            {
+              return false;
+            }
+          }
+          for (std::size_t i = 0; i < n; ++i)
+          {
+            // wraps like the other operations
+            lhs[i] = val[i] == -1 ? static_cast<std::int64_t>(0 - static_cast<std::uint64_t>(lhs[i])) :
+              lhs[i] / val[i];
+          }
+          break;
+        }
+      }
+
+      return true;
+    }
+
+    auto const n = dbls_.size();
+    auto const lhs = dbls_.data();
+    auto const val = rhs.dbls_.data();
+
+    switch (op)
+    {
+      case Op::add:
+        Simd::add(lhs, val, n);
+        break;
+
+      case Op::sub:
+        Simd::sub(lhs, val, n);
+        break;
+
+      case Op::mlt:
+        Simd::mlt(lhs, val, n);
+        break;
+
+      case Op::div:
+        Simd::div(lhs, val, n);
+        break;
+
+      case Op::min:
+        Simd::min(lhs, val, n);
+        break;
+
+      default:
+        Simd::max(lhs, val, n);
+        break;
+    }
+
+    return true;
+  }
+
+  std::string Array::sum() const
+  {
+    std::string res;
+    if (type_ == Type::integer)
+    {
+      Conv::set_int(res, Simd::sum(ints_.data(), ints_.size()));
+    }
+    else
+    {
+      Conv::set_dbl(res, Simd::sum(dbls_.data(), dbls_.size()));
+    }
+    return res;
+  }
+
+  std::string Array::dot(Array const& rhs) const
+  {
+    std::string res;
+    if (type_ == Type::integer)
+    {
+      Conv::set_int(res, Simd::dot(ints_.data(), rhs.ints_.data(), ints_.size()));
+    }
+    else
+    {
+      Conv::set_dbl(res, Simd::dot(dbls_.data(), rhs.dbls_.data(), dbls_.size()));
+    }
+    return res;
+  }
+
+  bool Array::overflows(Op const op, Array const& rhs) const
+  {
+    if (type_ != Type::integer)
+    {
+      return false;
+    }
+
+    std::int64_t r {0};
+    for (std::size_t i = 0; i < ints_.size(); ++i)
+    {
+      auto const a = ints_[i];
+      auto const b = rhs.ints_[i];
+      switch (op)
+      {
+        case Op::add:
+          if (__builtin_add_overflow(a, b, &r))
+          {
+            return true;
+          }
+          break;
+
+        case Op::sub:
+          if (__builtin_sub_overflow(a, b, &r))
+          {
+            return true;
+          }
+          break;
+
+        case Op::mlt:
+          if (__builtin_mul_overflow(a, b, &r))
+          {
+            return true;
+          }
+          break;
+
+        case Op::div:
+          if (b == -1 && __builtin_sub_overflow(std::int64_t {0}, a, &r))
+          {
+            return true;
+          }
+          break;
+
+        default:
+          return false;
+      }
+    }
+
+    return false;
+  }
+
+  bool Array::overflows_sum() const
+  {
+    if (type_ != Type::integer)
+    {
+      return false;
+    }
+
+    std::int64_t sum {0};
+    std::int64_t wraps {0};
+    for (auto const e : ints_)
+    {
+      add_wrapped(sum, e, wraps);
+    }
+
+    return wraps != 0;
+  }
+
+  bool Array::overflows_dot(Array const& rhs) const
+  {
+    if (type_ != Type::integer)
+    {
+      return false;
+    }
+
+    std::int64_t sum {0};
+    std::int64_t wraps {0};
+    for (std::size_t i = 0; i < ints_.size(); ++i)
+    {
+      std::int64_t r {0};
+      if (__builtin_mul_overflow(ints_[i], rhs.ints_[i], &r))
+      {
+        return true;
+      }
+      add_wrapped(sum, r, wraps);
+    }
+
+    return wraps != 0;
+  }
+} // namespace OB
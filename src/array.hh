@@ -0,0 +1,100 @@
+#ifndef OB_ARRAY_HH
+#define OB_ARRAY_HH
+
+#include "io.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace OB
+{
+// contiguous elements of one type, held by a value of type 'arr'
+class Array
+{
+public:
+  enum class Type
+  {
+    integer,
+    real,
+    string,
+  };
+
+  // element-wise operations of vadd, vsub, vmlt, vdiv, vmin and vmax
+  enum class Op
+  {
+    add,
+    sub,
+    mlt,
+    div,
+    min,
+    max,
+  };
+
+  // size elements of 0, 0.0 or the empty string
+  Array(Type const type, std::size_t const size);
+
+  // str elements that view bytes of a file mapping instead of
+  // holding them, copied into their own text on the first set or append
+  explicit Array(std::shared_ptr<Mmap const> fmap);
+
+  // appends the len bytes at off of the mapping of a view array
+  void append_view(std::size_t const off, std::size_t const len);
+
+  // the bytes of the mapping an element views,
+  // false when the element holds its own text
+  bool view(std::size_t const index, std::shared_ptr<Mmap const>& fmap,
+    std::size_t& off, std::size_t& len) const;
+
+  Type type() const;
+  std::size_t size() const;
+
+  // type of a value holding an element, 'int', 'dbl' or 'str'
+  char const* value_type() const;
+
+  // element as the text a value of value_type holds
+  std::string get(std::size_t const index) const;
+
+  // stores the text of a value of value_type
+  // returns false if it is not a number of the element type
+  bool set(std::size_t const index, std::string const& val);
+  bool append(std::string const& val);
+
+  // this[i] = this[i] op rhs[i] for int and dbl arrays of the same type
+  // and size, returns false and leaves the array as it was when an int
+  // is divided by zero
+  bool combine(Op const op, Array const& rhs);
+
+  // sum of the elements and of the products with rhs,
+  // as the text a value of value_type holds, ints wrap around
+  std::string sum() const;
+  std::string dot(Array const& rhs) const;
+
+  // true when an int result of combine, sum or dot does not fit
+  // in 64 bits and wraps, always false for dbl arrays
+  bool overflows(Op const op, Array const& rhs) const;
+  bool overflows_sum() const;
+  bool overflows_dot(Array const& rhs) const;
+
+private:
+  // copies the viewed elements into strs_
+  void own();
+
+  Type type_;
+
+  // only the vector of the element type is used
+  std::vector<std::int64_t> ints_;
+  std::vector<double> dbls_;
+  std::vector<std::string> strs_;
+
+  // set while the str elements are views, spans_ then holds them
+  std::shared_ptr<Mmap const> fmap_;
+  std::vector<std::pair<std::size_t, std::size_t>> spans_;
+}; // class Array
+
+} // namespace OB
+
+#endif // OB_ARRAY_HH
@@ -0,0 +1,685 @@
+#include "parg.hh"
+using Parg = OB::Parg;
+
+#include "pine.hh"
+using Pine = OB::Pine;
+
+#define FMT_HEADER_ONLY
+#include "format.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#ifndef PINE_BENCH_DIR
+#define PINE_BENCH_DIR "benchmarks"
+#endif
+
+#ifndef PINE_BUILD_TYPE
+#define PINE_BUILD_TYPE ""
+#endif
+
+struct Result
+{
+  std::string name;
+  int status {0};
+  std::uint64_t instructions {0};
+  long peak_rss_kb {0};
+
+  // wall time of each run
+  std::vector<double> samples;
+
+  // median and 95% confidence interval of ns per instruction
+  double ns {0};
+  double ns_low {0};
+  double ns_high {0};
+};
+
+// minimal json value, enough to read back a pine-bench report
+struct Json
+{
+  enum class Type
+  {
+    null,
+    boolean,
+    number,
+    string,
+    array,
+    object,
+  };
+
+  Type type {Type::null};
+  bool boolean {false};
+  double number {0};
+  std::string string;
+  std::vector<Json> array;
+  std::map<std::string, Json> object;
+};
+
+// fixed size record sent from the child back to the harness
+struct Record
+{
+  int status;
+  std::uint64_t instructions;
+  std::int64_t ns;
+};
+
+int program_options(Parg& pg);
+std::vector<std::string> list_workloads(std::string const& dir);
+bool run_workload(std::string const& path, std::string const& cwd, int const opt, bool const vm, Result& res);
+void summarize(Result& res);
+std::string to_json(std::vector<Result> const& results, int const opt, bool const vm);
+bool parse_json(std::string const& str, std::size_t& pos, Json& val);
+bool load_baseline(std::string const& file, Json& val);
+int compare(std::vector<Result> const& results, Json const& baseline, double const threshold, int const opt);
+void remove_dir(std::string const& dir);
+
+int program_options(Parg& pg)
+{
+  pg.name("pine-bench").version("0.2.0");
+  pg.description("runs the pine benchmark workloads");
+  pg.usage("[flags] [options]");
+  pg.usage("[-v|--version]");
+  pg.usage("[-h|--help]");
+  pg.info("Exit Codes", {"0 -> normal", "1 -> error", "2 -> performance regression"});
+  pg.author("octobanana (Brett Robinson) <octobanana.dev@gmail.com>");
+
+  pg.set("help,h", "print the help output");
+  pg.set("version,v", "print the program version");
+  pg.set("dir,d", PINE_BENCH_DIR, "dir_name", "directory of .pn workloads");
+  pg.set("output,o", "", "file_name", "write the json report to a file instead of stdout");
+  pg.set("runs,r", "5", "num", "number of runs of each workload");
+  pg.set("compare,c", "", "file_name", "compare against a json report saved from an earlier run");
+  pg.set("opt,O", "0", "level", "optimization level of the interpreter, 0, 1 or 2");
+  pg.set("vm", "run the workloads on the register vm");
+  pg.set("threshold,t", "5", "percent", "slowdown in ns per instruction that counts as a regression");
+
+  int status {pg.parse()};
+  if (status < 0)
+  {
+    std::cout << pg.print_help() << "\n";
+    std::cout << "Error: " << pg.error() << "\n";
+    return -1;
+  }
+  if (pg.get<bool>("help"))
+  {
+    std::cout << pg.print_help();
+    return 1;
+  }
+  if (pg.get<bool>("version"))
+  {
+    std::cout << pg.print_version();
+    return 1;
+  }
+  return 0;
+}
+
+std::vector<std::string> list_workloads(std::string const& dir)
+{
+  std::vector<std::string> files;
+
+  DIR* d {opendir(dir.c_str())};
+  if (d == nullptr)
+  {
+    return files;
+  }
+
+  while (auto e = readdir(d))
+  {
+    std::string const name {e->d_name};
+    if (name.size() > 3 && name.compare(name.size() - 3, 3, ".pn") == 0)
+    {
+      files.emplace_back(name);
+    }
+  }
+  closedir(d);
+
+  std::sort(files.begin(), files.end());
+
+  return files;
+}
+
+bool run_workload(std::string const& path, std::string const& cwd, int const opt, bool const vm, Result& res)
+{
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    return false;
+  }
+
+  std::fflush(stdout);
+  std::fflush(stderr);
+
+  pid_t const pid {fork()};
+  if (pid < 0)
+  {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0)
+  {
+    // child, runs the workload in its own process so rusage covers only it
+    close(fds[0]);
+
+    int const null {open("/dev/null", O_RDWR)};
+    dup2(null, STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+
+    Record rec {1, 0, 0};
+    if (chdir(cwd.c_str()) == 0)
+    {
+      Pine pine;
+      pine.set_file(path);
+      pine.set_opt(opt);
+      pine.set_vm(vm);
+
+      auto const start = std::chrono::steady_clock::now();
+      rec.status = pine.run();
+      auto const end = std::chrono::steady_clock::now();
+
+      rec.instructions = pine.instructions();
+      rec.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+
+    std::fflush(stdout);
+    auto const n = write(fds[1], &rec, sizeof(rec));
+    _exit(n == sizeof(rec) ? 0 : 1);
+  }
+
+  close(fds[1]);
+
+  Record rec {1, 0, 0};
+  bool const got {read(fds[0], &rec, sizeof(rec)) == sizeof(rec)};
+  close(fds[0]);
+
+  int wstatus {0};
+  struct rusage ru;
+  if (wait4(pid, &wstatus, 0, &ru) < 0 || ! got)
+  {
+    return false;
+  }
+
+  res.status = std::max(res.status, rec.status);
+  res.instructions = rec.instructions;
+  res.samples.emplace_back(static_cast<double>(rec.ns) / 1e9);
+  res.peak_rss_kb = std::max(res.peak_rss_kb, ru.ru_maxrss);
+
+  return true;
+}
+
+void summarize(Result& res)
+{
+  if (res.samples.empty() || res.instructions == 0)
+  {
+    return;
+  }
+
+  std::vector<double> ns;
+  for (auto const& e : res.samples)
+  {
+    ns.emplace_back(e * 1e9 / static_cast<double>(res.instructions));
+  }
+  std::sort(ns.begin(), ns.end());
+
+  auto const n = ns.size();
+  res.ns = n % 2 == 1 ? ns.at(n / 2) : (ns.at(n / 2 - 1) + ns.at(n / 2)) / 2;
+
+  // distribution free interval for the median from the binomial order statistics,
+  // the widest one, min to max, when there are too few runs for 95%
+  std::size_t k {0};
+  double tail {std::pow(0.5, static_cast<double>(n))};
+  double cdf {tail};
+  for (std::size_t i = 1; i < n / 2; ++i)
+  {
+    tail *= static_cast<double>(n - i + 1) / static_cast<double>(i);
+    cdf += tail;
+    if (cdf > 0.025)
+    {
+      break;
+    }
+    k = i;
+  }
+  res.ns_low = ns.at(k);
+  res.ns_high = ns.at(n - 1 - k);
+}
+
+std::string to_json(std::vector<Result> const& results, int const opt, bool const vm)
+{
+  std::string out;
+  out += "{\n";
+  out += fmt::format("  \"pine\": \"{}\",\n", "0.2.0");
+  out += fmt::format("  \"build\": \"{}\",\n", PINE_BUILD_TYPE);
+  out += fmt::format("  \"opt\": {},\n", opt);
+  out += fmt::format("  \"vm\": {},\n", vm ? "true" : "false");
+  out += "  \"workloads\": [";
+
+  for (std::size_t i = 0; i < results.size(); ++i)
+  {
+    auto const& e = results.at(i);
+    double const seconds {e.ns * static_cast<double>(e.instructions) / 1e9};
+    double const ips {e.ns > 0 ? 1e9 / e.ns : 0};
+
+    out += i == 0 ? "\n" : ",\n";
+    out += "    {";
+    out += fmt::format("\"name\": \"{}\", ", e.name);
+    out += fmt::format("\"status\": {}, ", e.status);
+    out += fmt::format("\"runs\": {}, ", e.samples.size());
+    out += fmt::format("\"instructions\": {}, ", e.instructions);
+    out += fmt::format("\"seconds\": {:.6f}, ", seconds);
+    out += fmt::format("\"ips\": {:.1f}, ", ips);
+    out += fmt::format("\"ns_per_ins\": {:.3f}, ", e.ns);
+    out += fmt::format("\"ns_per_ins_ci\": [{:.3f}, {:.3f}], ", e.ns_low, e.ns_high);
+    out += fmt::format("\"peak_rss_kb\": {}", e.peak_rss_kb);
+    out += "}";
+  }
+
+  out += "\n  ]\n}\n";
+
+  return out;
+}
+
+bool parse_json(std::string const& str, std::size_t& pos, Json& val)
+{
+  auto const skip = [&]()
+  {
+    while (pos < str.size() && std::isspace(static_cast<unsigned char>(str.at(pos))))
+    {
+      ++pos;
+    }
+  };
+
+  auto const literal = [&](std::string const& lit)
+  {
+    if (str.compare(pos, lit.size(), lit) != 0)
+    {
+      return false;
+    }
+    pos += lit.size();
+    return true;
+  };
+
+  auto const parse_string = [&](std::string& out)
+  {
+    // opening quote already checked
+    ++pos;
+    while (pos < str.size() && str.at(pos) != '"')
+    {
+      if (str.at(pos) == '\\' && pos + 1 < str.size())
+      {
+        ++pos;
+      }
+      out += str.at(pos++);
+    }
+    if (pos >= str.size())
+    {
+      return false;
+    }
+    ++pos;
+    return true;
+  };
+
+  skip();
+  if (pos >= str.size())
+  {
+    return false;
+  }
+
+  char const c {str.at(pos)};
+  if (c == '{')
+  {
+    val.type = Json::Type::object;
+    ++pos;
+    skip();
+    if (pos < str.size() && str.at(pos) == '}')
+    {
+      ++pos;
+      return true;
+    }
+    for (;;)
+    {
+      skip();
+      std::string key;
+      if (pos >= str.size() || str.at(pos) != '"' || ! parse_string(key))
+      {
+        return false;
+      }
+      skip();
+      if (pos >= str.size() || str.at(pos) != ':')
+      {
+        return false;
+      }
+      ++pos;
+      if (! parse_json(str, pos, val.object[key]))
+      {
+        return false;
+      }
+      skip();
+      if (pos < str.size() && str.at(pos) == ',')
+      {
+        ++pos;
+        continue;
+      }
+      if (pos < str.size() && str.at(pos) == '}')
+      {
+        ++pos;
+        return true;
+      }
+      return false;
+    }
+  }
+  if (c == '[')
+  {
+    val.type = Json::Type::array;
+    ++pos;
+    skip();
+    if (pos < str.size() && str.at(pos) == ']')
+    {
+      ++pos;
+      return true;
+    }
+    for (;;)
+    {
+      val.array.emplace_back();
+      if (! parse_json(str, pos, val.array.back()))
+      {
+        return false;
+      }
+      skip();
+      if (pos < str.size() && str.at(pos) == ',')
+      {
+        ++pos;
+        continue;
+      }
+      if (pos < str.size() && str.at(pos) == ']')
+      {
+        ++pos;
+        return true;
+      }
+      return false;
+    }
+  }
+  if (c == '"')
+  {
+    val.type = Json::Type::string;
+    return parse_string(val.string);
+  }
+  if (literal("true") || literal("false"))
+  {
+    val.type = Json::Type::boolean;
+    val.boolean = str.at(pos - 1) == 'e' && str.at(pos - 2) == 'u';
+    return true;
+  }
+  if (literal("null"))
+  {
+    val.type = Json::Type::null;
+    return true;
+  }
+
+  char const* begin {str.c_str() + pos};
+  char* end {nullptr};
+  val.type = Json::Type::number;
+  val.number = std::strtod(begin, &end);
+  if (end == begin)
+  {
+    return false;
+  }
+  pos += static_cast<std::size_t>(end - begin);
+
+  return true;
+}
+
+bool load_baseline(std::string const& file, Json& val)
+{
+  std::ifstream ifile {file};
+  if (! ifile.is_open())
+  {
+    return false;
+  }
+
+  std::stringstream ss;
+  ss << ifile.rdbuf();
+
+  std::size_t pos {0};
+  return parse_json(ss.str(), pos, val) && val.type == Json::Type::object;
+}
+
+int compare(std::vector<Result> const& results, Json const& baseline, double const threshold, int const opt)
+{
+  auto const field = [](Json const& obj, std::string const& key) -> Json const*
+  {
+    auto const it = obj.object.find(key);
+    if (it == obj.object.end())
+    {
+      return nullptr;
+    }
+    return &it->second;
+  };
+
+  auto const build = field(baseline, "build");
+  if (build == nullptr || build->string != PINE_BUILD_TYPE)
+  {
+    std::cerr << "Error: baseline was recorded with a '" << (build ? build->string : "")
+      << "' build, this is a '" << PINE_BUILD_TYPE << "' build\n";
+    return 1;
+  }
+
+  // reports from before optimization levels ran everything at 0
+  auto const level = field(baseline, "opt");
+  int const base_opt {level != nullptr ? static_cast<int>(level->number) : 0};
+  if (base_opt != opt)
+  {
+    std::cerr << "Error: baseline was recorded at optimization level " << base_opt
+      << ", this run is at level " << opt << "\n";
+    return 1;
+  }
+
+  std::map<std::string, Json const*> base;
+  auto const workloads = field(baseline, "workloads");
+  if (workloads != nullptr)
+  {
+    for (auto const& e : workloads->array)
+    {
+      auto const name = field(e, "name");
+      if (name != nullptr)
+      {
+        base[name->string] = &e;
+      }
+    }
+  }
+
+  int status {0};
+  fmt::print(stderr, "\n{:<12} {:>12} {:>12} {:>9}  {}\n", "workload", "base ns/ins", "ns/ins", "change", "result");
+  for (auto const& e : results)
+  {
+    auto const it = base.find(e.name);
+    if (it == base.end())
+    {
+      fmt::print(stderr, "{:<12} {:>12} {:>12.3f} {:>9}  {}\n", e.name, "-", e.ns, "-", "new");
+      continue;
+    }
+
+    auto const ns = field(*it->second, "ns_per_ins");
+    auto const ci = field(*it->second, "ns_per_ins_ci");
+    auto const ins = field(*it->second, "instructions");
+    if (ns == nullptr || ns->number <= 0)
+    {
+      fmt::print(stderr, "{:<12} {:>12} {:>12.3f} {:>9}  {}\n", e.name, "-", e.ns, "-", "invalid");
+      continue;
+    }
+    double const base_high {ci && ci->array.size() == 2 ? ci->array.at(1).number : ns->number};
+
+    // a regression has to be past the threshold and outside the noise of both runs
+    double const change {(e.ns - ns->number) / ns->number * 100};
+    bool const slower {e.ns > ns->number * (1 + threshold / 100) && e.ns_low > base_high};
+
+    std::string result {slower ? "regression" : "ok"};
+    if (ins && static_cast<std::uint64_t>(ins->number) != e.instructions)
+    {
+      result += " (instruction count changed)";
+    }
+    if (slower)
+    {
+      status = 2;
+    }
+
+    fmt::print(stderr, "{:<12} {:>12.3f} {:>12.3f} {:>+8.1f}%  {}\n", e.name, ns->number, e.ns, change, result);
+  }
+
+  return status;
+}
+
+void remove_dir(std::string const& dir)
+{
+  DIR* d {opendir(dir.c_str())};
+  if (d != nullptr)
+  {
+    while (auto e = readdir(d))
+    {
+      std::string const name {e->d_name};
+      if (name != "." && name != "..")
+      {
+        unlink((dir + "/" + name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+  Parg pg {argc, argv};
+  int pstatus {program_options(pg)};
+  if (pstatus > 0) return 0;
+  else if (pstatus < 0) return 1;
+
+  std::string dir {pg.get("dir")};
+  char* real {realpath(dir.c_str(), nullptr)};
+  if (real == nullptr)
+  {
+    // error
+    std::cerr << "Error: could not open directory '" << dir << "'\n";
+    return 1;
+  }
+  dir = real;
+  std::free(real);
+
+  int const runs {pg.get<int>("runs")};
+  if (runs < 1)
+  {
+    // error
+    std::cerr << "Error: runs must be at least 1\n";
+    return 1;
+  }
+
+  int const opt {pg.get<int>("opt")};
+  if (opt < 0 || opt > 2)
+  {
+    // error
+    std::cerr << "Error: opt must be 0, 1 or 2\n";
+    return 1;
+  }
+
+  Json baseline;
+  if (pg.find("compare") && ! load_baseline(pg.get("compare"), baseline))
+  {
+    // error
+    std::cerr << "Error: could not read baseline '" << pg.get("compare") << "'\n";
+    return 1;
+  }
+
+  auto const workloads = list_workloads(dir);
+  if (workloads.empty())
+  {
+    // error
+    std::cerr << "Error: no workloads found in '" << dir << "'\n";
+    return 1;
+  }
+
+  // workloads that write files do so in a scratch directory
+  char tmpl[] {"/tmp/pine-bench-XXXXXX"};
+  if (mkdtemp(tmpl) == nullptr)
+  {
+    // error
+    std::cerr << "Error: could not create a scratch directory\n";
+    return 1;
+  }
+  std::string const cwd {tmpl};
+
+  int status {0};
+  std::vector<Result> results;
+  for (auto const& e : workloads)
+  {
+    Result res;
+    res.name = e.substr(0, e.size() - 3);
+
+    bool ok {true};
+    for (int i = 0; i < runs && ok; ++i)
+    {
+      ok = run_workload(dir + "/" + e, cwd, opt, pg.get<bool>("vm"), res);
+    }
+    if (! ok)
+    {
+      std::cerr << "Error: could not run workload '" << res.name << "'\n";
+      status = 1;
+      continue;
+    }
+    if (res.status != 0)
+    {
+      std::cerr << "Error: workload '" << res.name << "' exited with " << res.status << "\n";
+      status = 1;
+    }
+
+    summarize(res);
+    fmt::print(stderr, "{:<12} {:>10} ins {:>10.1f} ns/ins  [{:.1f}, {:.1f}]\n", res.name,
+      res.instructions, res.ns, res.ns_low, res.ns_high);
+
+    results.emplace_back(res);
+  }
+
+  remove_dir(cwd);
+
+  if (pg.find("compare") && status == 0)
+  {
+    status = compare(results, baseline, pg.get<double>("threshold"), opt);
+  }
+
+  auto const json = to_json(results, opt, pg.get<bool>("vm"));
+  if (pg.find("output"))
+  {
+    std::FILE* file {std::fopen(pg.get("output").c_str(), "w")};
+    if (file == nullptr)
+    {
+      // error
+      std::cerr << "Error: could not open file '" << pg.get("output") << "'\n";
+      return 1;
+    }
+    std::fputs(json.c_str(), file);
+    std::fclose(file);
+  }
+  else
+  {
+    std::fputs(json.c_str(), stdout);
+  }
+
+  return status;
+}
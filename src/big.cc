@@ -0,0 +1,484 @@
+#include "big.hh"
+
+#include <algorithm>
+#include <utility>
+
+namespace OB
+{
+  namespace
+  {
+    using Mag = std::vector<std::uint32_t>;
+
+    // value and decimal digits of a limb
+    constexpr std::uint32_t base {1000000000};
+    constexpr std::size_t limb_digits {9};
+
+    // limbs of the shorter factor below which schoolbook
+    // multiplication is faster than splitting it
+    constexpr std::size_t karatsuba_min {32};
+
+    bool is_space(char const c)
+    {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    void trim(Mag& a)
+    {
+      while (! a.empty() && a.back() == 0)
+      {
+        a.pop_back();
+      }
+    }
+
+    int compare_mag(Mag const& a, Mag const& b)
+    {
+      if (a.size() != b.size())
+      {
+        return a.size() < b.size() ? -1 : 1;
+      }
+      for (std::size_t i = a.size(); i-- > 0;)
+      {
+        if (a[i] != b[i])
+        {
+          return a[i] < b[i] ? -1 : 1;
+        }
+      }
+      return 0;
+    }
+
+    // a += b shifted left by off limbs
+    void add_mag(Mag& a, std::uint32_t const* b, std::size_t const n, std::size_t const off)
+    {
+      if (a.size() < off + n)
+      {
+        a.resize(off + n, 0);
+      }
+      std::uint32_t carry {0};
+      std::size_t i {0};
+      for (; i < n || carry != 0; ++i)
+      {
+        if (off + i == a.size())
+        {
+          a.emplace_back(0);
+        }
+        std::uint32_t sum {a[off + i] + carry + (i < n ? b[i] : 0)};
+        carry = sum >= base ? 1 : 0;
+        a[off + i] = sum - carry * base;
+      }
+    }
+
+    // a -= b, a must not be less than b
+    void sub_mag(Mag& a, Mag const& b)
+    {
+      std::uint32_t borrow {0};
+      for (std::size_t i = 0; i < b.size() || borrow != 0; ++i)
+      {
+        std::uint32_t const rhs {(i < b.size() ? b[i] : 0) + borrow};
+        borrow = a[i] < rhs ? 1 : 0;
+        a[i] = a[i] + borrow * base - rhs;
+      }
+      trim(a);
+    }
+
+    // a *= m in place, the fast path for a factor of one limb
+    void mlt_small(Mag& a, std::uint32_t const m)
+    {
+      if (m == 0)
+      {
+        a.clear();
+        return;
+      }
+      std::uint64_t carry {0};
+      for (auto& e : a)
+      {
+        std::uint64_t const cur {static_cast<std::uint64_t>(e) * m + carry};
+        e = static_cast<std::uint32_t>(cur % base);
+        carry = cur / base;
+      }
+      if (carry != 0)
+      {
+        a.emplace_back(static_cast<std::uint32_t>(carry));
+      }
+    }
+
+    // a /= d in place, returns the remainder
+    std::uint32_t div_small(Mag& a, std::uint32_t const d)
+    {
+      std::uint64_t rem {0};
+      for (std::size_t i = a.size(); i-- > 0;)
+      {
+        std::uint64_t const cur {rem * base + a[i]};
+        a[i] = static_cast<std::uint32_t>(cur / d);
+        rem = cur % d;
+      }
+      trim(a);
+      return static_cast<std::uint32_t>(rem);
+    }
+
+    Mag mlt_school(std::uint32_t const* a, std::size_t const na,
+      std::uint32_t const* b, std::size_t const nb)
+    {
+      Mag res(na + nb, 0);
+      for (std::size_t i = 0; i < na; ++i)
+      {
+        if (a[i] == 0)
+        {
+          continue;
+        }
+        std::uint64_t carry {0};
+        for (std::size_t j = 0; j < nb; ++j)
+        {
+          std::uint64_t const cur {res[i + j] + static_cast<std::uint64_t>(a[i]) * b[j] + carry};
+          res[i + j] = static_cast<std::uint32_t>(cur % base);
+          carry = cur / base;
+        }
+        res[i + nb] = static_cast<std::uint32_t>(carry);
+      }
+      trim(res);
+      return res;
+    }
+
+    Mag mlt_mag(std::uint32_t const* a, std::size_t na, std::uint32_t const* b, std::size_t nb)
+    {
+      while (na > 0 && a[na - 1] == 0)
+      {
+        --na;
+      }
+      while (nb > 0 && b[nb - 1] == 0)
+      {
+        --nb;
+      }
+      if (na < nb)
+      {
+        std::swap(a, b);
+        std::swap(na, nb);
+      }
+      if (nb == 0)
+      {
+        return {};
+      }
+      if (nb < karatsuba_min)
+      {
+        return mlt_school(a, na, b, nb);
+      }
+
+      Mag res;
+      if (nb <= na / 2)
+      {
+        // unbalanced, multiply b by pieces of a its size
+        for (std::size_t off = 0; off < na; off += nb)
+        {
+          auto const part = mlt_mag(a + off, std::min(nb, na - off), b, nb);
+          add_mag(res, part.data(), part.size(), off);
+        }
+        trim(res);
+        return res;
+      }
+
+      // a = a1 * B^h + a0 and b = b1 * B^h + b0, three products instead of four,
+      // a0 * b0, a1 * b1 and (a0 + a1) * (b0 + b1) less the other two
+      std::size_t const h {na / 2};
+      auto const z0 = mlt_mag(a, h, b, h);
+      auto const z2 = mlt_mag(a + h, na - h, b + h, nb - h);
+
+      Mag sa(a, a + h);
+      add_mag(sa, a + h, na - h, 0);
+      Mag sb(b, b + h);
+      add_mag(sb, b + h, nb - h, 0);
+      auto z1 = mlt_mag(sa.data(), sa.size(), sb.data(), sb.size());
+      sub_mag(z1, z0);
+      sub_mag(z1, z2);
+
+      res.reserve(na + nb + 1);
+      add_mag(res, z0.data(), z0.size(), 0);
+      add_mag(res, z1.data(), z1.size(), h);
+      add_mag(res, z2.data(), z2.size(), 2 * h);
+      trim(res);
+      return res;
+    }
+
+    // q = u / v and r = u % v, v must not be zero, Knuth's algorithm D
+    void divmod_mag(Mag const& u, Mag const& v, Mag& q, Mag& r)
+    {
+      if (compare_mag(u, v) < 0)
+      {
+        q.clear();
+        r = u;
+        return;
+      }
+      if (v.size() == 1)
+      {
+        q = u;
+        auto const rem = div_small(q, v[0]);
+        r.clear();
+        if (rem != 0)
+        {
+          r.emplace_back(rem);
+        }
+        return;
+      }
+
+      // scale both so the top limb of v is at least half the base,
+      // then each estimated quotient limb is at most one too large
+      auto const n = v.size();
+      auto const m = u.size() - n;
+      auto const d = static_cast<std::uint32_t>(base / (static_cast<std::uint64_t>(v.back()) + 1));
+      Mag un {u};
+      mlt_small(un, d);
+      if (un.size() == u.size())
+      {
+        un.emplace_back(0);
+      }
+      Mag vn {v};
+      mlt_small(vn, d);
+
+      std::uint64_t const vtop {vn[n - 1]};
+      std::uint64_t const vnext {vn[n - 2]};
+      q.assign(m + 1, 0);
+      for (std::size_t j = m + 1; j-- > 0;)
+      {
+        std::uint64_t const num {static_cast<std::uint64_t>(un[j + n]) * base + un[j + n - 1]};
+        std::uint64_t qhat {num / vtop};
+        std::uint64_t rhat {num % vtop};
+        while (qhat >= base || qhat * vnext > rhat * base + un[j + n - 2])
+        {
+          --qhat;
+          rhat += vtop;
+          if (rhat >= base)
+          {
+            break;
+          }
+        }
+
+        // un -= qhat * vn shifted by j
+        std::uint64_t carry {0};
+        std::int64_t borrow {0};
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          std::uint64_t const p {qhat * vn[i] + carry};
+          carry = p / base;
+          std::int64_t t {static_cast<std::int64_t>(un[i + j]) - static_cast<std::int64_t>(p % base) - borrow};
+          borrow = t < 0 ? 1 : 0;
+          un[i + j] = static_cast<std::uint32_t>(t + borrow * base);
+        }
+        std::int64_t t {static_cast<std::int64_t>(un[j + n]) - static_cast<std::int64_t>(carry) - borrow};
+        borrow = t < 0 ? 1 : 0;
+        un[j + n] = static_cast<std::uint32_t>(t + borrow * base);
+
+        if (borrow != 0)
+        {
+          // qhat was one too large, add vn back
+          --qhat;
+          std::uint64_t c {0};
+          for (std::size_t i = 0; i < n; ++i)
+          {
+            std::uint64_t const s {static_cast<std::uint64_t>(un[i + j]) + vn[i] + c};
+            un[i + j] = static_cast<std::uint32_t>(s % base);
+            c = s / base;
+          }
+          un[j + n] = static_cast<std::uint32_t>((un[j + n] + c) % base);
+        }
+
+        q[j] = static_cast<std::uint32_t>(qhat);
+      }
+      trim(q);
+
+      un.resize(n);
+      trim(un);
+      div_small(un, d);
+      r = std::move(un);
+    }
+  } // namespace
+
+  Conv::Error Big::parse(char const* first, char const* last, Big& val)
+  {
+    while (first != last && is_space(*first))
+    {
+      ++first;
+    }
+    while (first != last && is_space(*(last - 1)))
+    {
+      --last;
+    }
+
+    bool neg {false};
+    if (first != last && (*first == '-' || *first == '+'))
+    {
+      neg = *first == '-';
+      ++first;
+    }
+    if (first == last)
+    {
+      return Conv::Error::invalid;
+    }
+    for (auto it = first; it != last; ++it)
+    {
+      if (*it < '0' || *it > '9')
+      {
+        return Conv::Error::invalid;
+      }
+    }
+    while (first != last && *first == '0')
+    {
+      ++first;
+    }
+
+    // nine digits at a time from the end
+    Mag mag;
+    mag.reserve(static_cast<std::size_t>(last - first) / limb_digits + 1);
+    while (last != first)
+    {
+      auto const begin = static_cast<std::size_t>(last - first) > limb_digits ? last - limb_digits : first;
+      std::uint32_t limb {0};
+      for (auto it = begin; it != last; ++it)
+      {
+        limb = limb * 10 + static_cast<std::uint32_t>(*it - '0');
+      }
+      mag.emplace_back(limb);
+      last = begin;
+    }
+
+    val.neg_ = neg && ! mag.empty();
+    val.mag_ = std::move(mag);
+
+    return Conv::Error::none;
+  }
+
+  void Big::write(std::string& text) const
+  {
+    if (mag_.empty())
+    {
+      text.assign(1, '0');
+      return;
+    }
+
+    // the top limb has no leading zeros, every other one has nine digits
+    char top[Conv::buffer_size];
+    auto const top_size = Conv::write_int(top, mag_.back());
+    std::size_t const sign {neg_ ? 1u : 0u};
+    text.resize(sign + top_size + (mag_.size() - 1) * limb_digits);
+    auto out = &text[0];
+    if (neg_)
+    {
+      out[0] = '-';
+    }
+    std::copy(top, top + top_size, out + sign);
+
+    // two digits at a time from a table
+    static char const pairs[] {
+      "0001020304050607080910111213141516171819"
+      "2021222324252627282930313233343536373839"
+      "4041424344454647484950515253545556575859"
+      "6061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899"};
+    auto end = out + text.size();
+    for (std::size_t i = 0; i + 1 < mag_.size(); ++i)
+    {
+      auto limb = mag_[i];
+      for (int j = 0; j < 4; ++j)
+      {
+        auto const pair = pairs + 2 * (limb % 100);
+        limb /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+      }
+      *--end = static_cast<char>('0' + limb);
+    }
+  }
+
+  int Big::compare(Big const& rhs) const
+  {
+    if (neg_ != rhs.neg_)
+    {
+      return neg_ ? -1 : 1;
+    }
+    auto const c = compare_mag(mag_, rhs.mag_);
+    return neg_ ? -c : c;
+  }
+
+  void Big::add(Big const& rhs)
+  {
+    if (neg_ == rhs.neg_)
+    {
+      add_mag(mag_, rhs.mag_.data(), rhs.mag_.size(), 0);
+      return;
+    }
+
+    // signs differ, the smaller magnitude comes off the larger
+    if (compare_mag(mag_, rhs.mag_) >= 0)
+    {
+      sub_mag(mag_, rhs.mag_);
+    }
+    else
+    {
+      Mag mag {rhs.mag_};
+      sub_mag(mag, mag_);
+      mag_ = std::move(mag);
+      neg_ = rhs.neg_;
+    }
+    if (mag_.empty())
+    {
+      neg_ = false;
+    }
+  }
+
+  void Big::sub(Big const& rhs)
+  {
+    Big neg {rhs};
+    neg.neg_ = ! rhs.neg_ && ! rhs.mag_.empty();
+    add(neg);
+  }
+
+  void Big::mlt(Big const& rhs)
+  {
+    bool const neg {neg_ != rhs.neg_};
+    if (rhs.mag_.size() == 1)
+    {
+      mlt_small(mag_, rhs.mag_[0]);
+    }
+    else if (mag_.size() == 1)
+    {
+      auto const m = mag_[0];
+      mag_ = rhs.mag_;
+      mlt_small(mag_, m);
+    }
+    else
+    {
+      mag_ = mlt_mag(mag_.data(), mag_.size(), rhs.mag_.data(), rhs.mag_.size());
+    }
+    neg_ = neg && ! mag_.empty();
+  }
+
+  bool Big::div(Big const& rhs)
+  {
+    if (rhs.mag_.empty())
+    {
+      return false;
+    }
+
+    bool const neg {neg_ != rhs.neg_};
+    Mag q;
+    Mag r;
+    divmod_mag(mag_, rhs.mag_, q, r);
+    mag_ = std::move(q);
+    neg_ = neg && ! mag_.empty();
+
+    return true;
+  }
+
+  bool Big::mod(Big const& rhs)
+  {
+    if (rhs.mag_.empty())
+    {
+      return false;
+    }
+
+    Mag q;
+    Mag r;
+    divmod_mag(mag_, rhs.mag_, q, r);
+    mag_ = std::move(r);
+    neg_ = neg_ && ! mag_.empty();
+
+    return true;
+  }
+} // namespace OB
@@ -0,0 +1,47 @@
+#ifndef OB_BIG_HH
+#define OB_BIG_HH
+
+#include "conv.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace OB
+{
+// integer of any size, the number of a value of type 'big',
+// held in limbs of nine decimal digits so it is read from and
+// written to the text of the value in linear time
+class Big
+{
+public:
+  // parses all of [first, last) like Conv::parse, the text of an int
+  // or a big, val is only written when the result is Error::none
+  static Conv::Error parse(char const* first, char const* last, Big& val);
+
+  // replaces text with the decimal digits
+  void write(std::string& text) const;
+
+  // -1, 0 or 1 as this is less than, equal to or greater than rhs
+  int compare(Big const& rhs) const;
+
+  void add(Big const& rhs);
+  void sub(Big const& rhs);
+  void mlt(Big const& rhs);
+
+  // truncate toward zero like int division, the remainder has the
+  // sign of this, return false and leave this as it was when rhs is zero
+  bool div(Big const& rhs);
+  bool mod(Big const& rhs);
+
+private:
+  bool neg_ {false};
+
+  // least significant limb first, no leading zero limbs, empty for zero
+  std::vector<std::uint32_t> mag_;
+}; // class Big
+
+} // namespace OB
+
+#endif // OB_BIG_HH
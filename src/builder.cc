@@ -0,0 +1,50 @@
+#include "builder.hh"
+
+#include <algorithm>
+
+namespace OB
+{
+  namespace
+  {
+    // capacity of the first chunk
+    constexpr std::size_t chunk_min {256};
+  } // namespace
+
+  void Builder::append(char const* data, std::size_t const size)
+  {
+    size_ += size;
+
+    auto rest = size;
+    while (rest > 0)
+    {
+      if (chunks_.empty() || chunks_.back().size() == chunks_.back().capacity())
+      {
+        auto const cap = chunks_.empty() ? chunk_min : chunks_.back().capacity() * 2;
+        chunks_.emplace_back();
+        chunks_.back().reserve(std::max(cap, rest));
+      }
+
+      auto& chunk = chunks_.back();
+      auto const n = std::min(rest, chunk.capacity() - chunk.size());
+      chunk.append(data, n);
+      data += n;
+      rest -= n;
+    }
+  }
+
+  std::size_t Builder::size() const
+  {
+    return size_;
+  }
+
+  std::string Builder::str() const
+  {
+    std::string res;
+    res.reserve(size_);
+    for (auto const& e : chunks_)
+    {
+      res.append(e);
+    }
+    return res;
+  }
+} // namespace OB
@@ -0,0 +1,31 @@
+#ifndef OB_BUILDER_HH
+#define OB_BUILDER_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace OB
+{
+// text appended in pieces, held by a value of type 'stb',
+// kept in chunks that double in size so earlier text is never copied
+// until str joins it into one string
+class Builder
+{
+public:
+  void append(char const* data, std::size_t const size);
+
+  std::size_t size() const;
+
+  // the text appended so far, allocated once
+  std::string str() const;
+
+private:
+  // every chunk but the last is full to its capacity
+  std::vector<std::string> chunks_;
+  std::size_t size_ {0};
+}; // class Builder
+
+} // namespace OB
+
+#endif // OB_BUILDER_HH
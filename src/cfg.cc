@@ -0,0 +1,303 @@
+#include "cfg.hh"
+
+#include <algorithm>
+#include <limits>
+
+namespace OB
+{
+  namespace
+  {
+    constexpr std::size_t none {std::numeric_limits<std::size_t>::max()};
+
+    bool is_branch(std::string const& op)
+    {
+      return op == "jeq" || op == "jne" || op == "jlt" || op == "jgt" || op == "jge" ||
+        op == "jle" || op == "itr";
+    }
+  } // namespace
+
+  Cfg::Cfg(Optimizer::Program const& program, Labels const& labels)
+  {
+    build_blocks(program, labels);
+    build_dominators();
+    build_loops();
+  }
+
+  std::vector<std::size_t> Cfg::successors(Optimizer::Program const& program,
+    Labels const& labels, std::size_t const i)
+  {
+    std::vector<std::size_t> succ;
+    auto const next = [&](std::size_t const n)
+    {
+      if (n < program.size())
+      {
+        succ.emplace_back(n);
+      }
+    };
+
+    // a jump to a missing label searches to the end of the file
+    auto const target = [&](std::string const& label)
+    {
+      auto const it = labels.find(label);
+      if (it != labels.end())
+      {
+        next(it->second);
+      }
+    };
+
+    // the loop ends after the last line, a jump there never happens
+    if (i + 1 == program.size())
+    {
+      return succ;
+    }
+
+    auto const& e = program.at(i);
+    if (! e.is_ins())
+    {
+      next(i + 1);
+    }
+    else if (e.op() == "jmp")
+    {
+      target(e.args.at(1));
+    }
+    else if (is_branch(e.op()) || e.op() == "run")
+    {
+      target(e.args.back());
+      next(i + 1);
+    }
+    else if (e.op() != "ret" && e.op() != "ext")
+    {
+      next(i + 1);
+    }
+
+    return succ;
+  }
+
+  std::vector<Cfg::Block> const& Cfg::blocks() const
+  {
+    return blocks_;
+  }
+
+  std::size_t Cfg::block_of(std::size_t const line) const
+  {
+    return block_of_.at(line);
+  }
+
+  bool Cfg::reachable(std::size_t const block) const
+  {
+    return idom_.at(block) != none;
+  }
+
+  bool Cfg::dominates(std::size_t const a, std::size_t const b) const
+  {
+    if (! reachable(a) || ! reachable(b))
+    {
+      return false;
+    }
+
+    std::size_t n {b};
+    for (;;)
+    {
+      if (n == a)
+      {
+        return true;
+      }
+      if (idom_.at(n) == n)
+      {
+        return false;
+      }
+      n = idom_.at(n);
+    }
+  }
+
+  std::vector<Cfg::Loop> const& Cfg::loops() const
+  {
+    return loops_;
+  }
+
+  void Cfg::build_blocks(Optimizer::Program const& program, Labels const& labels)
+  {
+    block_of_.assign(program.size(), 0);
+    if (program.empty())
+    {
+      return;
+    }
+
+    // a block starts at the entry, at a jump target and after any
+    // line that does not simply continue to the next one
+    std::vector<bool> leader(program.size(), false);
+    leader.at(0) = true;
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      auto const succ = successors(program, labels, i);
+      bool const straight {succ.size() == 1 && succ.front() == i + 1};
+      for (auto const s : succ)
+      {
+        if (s != i + 1)
+        {
+          leader.at(s) = true;
+        }
+      }
+      if (! straight && i + 1 < program.size())
+      {
+        leader.at(i + 1) = true;
+      }
+    }
+
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      if (leader.at(i))
+      {
+        Block b;
+        b.begin = i;
+        blocks_.emplace_back(b);
+      }
+      blocks_.back().end = i + 1;
+      block_of_.at(i) = blocks_.size() - 1;
+    }
+
+    for (std::size_t b = 0; b < blocks_.size(); ++b)
+    {
+      for (auto const s : successors(program, labels, blocks_.at(b).end - 1))
+      {
+        auto const t = block_of_.at(s);
+        if (std::find(blocks_.at(b).succ.begin(), blocks_.at(b).succ.end(), t) == blocks_.at(b).succ.end())
+        {
+          blocks_.at(b).succ.emplace_back(t);
+          blocks_.at(t).pred.emplace_back(b);
+        }
+      }
+    }
+  }
+
+  void Cfg::build_dominators()
+  {
+    idom_.assign(blocks_.size(), none);
+    if (blocks_.empty())
+    {
+      return;
+    }
+
+    // reverse postorder from the entry
+    std::vector<bool> seen(blocks_.size(), false);
+    std::vector<std::pair<std::size_t, std::size_t>> stack {{0, 0}};
+    seen.at(0) = true;
+    while (! stack.empty())
+    {
+      auto& top = stack.back();
+      auto const& succ = blocks_.at(top.first).succ;
+      if (top.second < succ.size())
+      {
+        auto const s = succ.at(top.second++);
+        if (! seen.at(s))
+        {
+          seen.at(s) = true;
+          stack.emplace_back(s, 0);
+        }
+      }
+      else
+      {
+        order_.emplace_back(top.first);
+        stack.pop_back();
+      }
+    }
+    std::reverse(order_.begin(), order_.end());
+
+    std::vector<std::size_t> rpo(blocks_.size(), none);
+    for (std::size_t i = 0; i < order_.size(); ++i)
+    {
+      rpo.at(order_.at(i)) = i;
+    }
+
+    auto const intersect = [&](std::size_t a, std::size_t b)
+    {
+      while (a != b)
+      {
+        while (rpo.at(a) > rpo.at(b))
+        {
+          a = idom_.at(a);
+        }
+        while (rpo.at(b) > rpo.at(a))
+        {
+          b = idom_.at(b);
+        }
+      }
+      return a;
+    };
+
+    // iterative dominators, Cooper, Harvey and Kennedy
+    idom_.at(0) = 0;
+    bool changed {true};
+    while (changed)
+    {
+      changed = false;
+      for (std::size_t i = 1; i < order_.size(); ++i)
+      {
+        auto const b = order_.at(i);
+        std::size_t dom {none};
+        for (auto const p : blocks_.at(b).pred)
+        {
+          if (idom_.at(p) == none)
+          {
+            continue;
+          }
+          dom = dom == none ? p : intersect(p, dom);
+        }
+        if (dom != idom_.at(b))
+        {
+          idom_.at(b) = dom;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  void Cfg::build_loops()
+  {
+    std::map<std::size_t, Loop> loops;
+    for (auto const b : order_)
+    {
+      for (auto const h : blocks_.at(b).succ)
+      {
+        if (! dominates(h, b))
+        {
+          continue;
+        }
+
+        // a back edge, the body is everything reaching the latch
+        // without passing through the header
+        auto& loop = loops[h];
+        loop.header = h;
+        loop.latches.emplace_back(b);
+        loop.blocks.emplace(h);
+
+        std::vector<std::size_t> work;
+        if (loop.blocks.emplace(b).second)
+        {
+          work.emplace_back(b);
+        }
+        while (! work.empty())
+        {
+          auto const n = work.back();
+          work.pop_back();
+          for (auto const p : blocks_.at(n).pred)
+          {
+            if (reachable(p) && loop.blocks.emplace(p).second)
+            {
+              work.emplace_back(p);
+            }
+          }
+        }
+      }
+    }
+
+    for (auto& e : loops)
+    {
+      loops_.emplace_back(std::move(e.second));
+    }
+    std::stable_sort(loops_.begin(), loops_.end(), [](Loop const& lhs, Loop const& rhs)
+    {
+      return lhs.blocks.size() < rhs.blocks.size();
+    });
+  }
+} // namespace OB
@@ -0,0 +1,72 @@
+#ifndef OB_CFG_HH
+#define OB_CFG_HH
+
+#include "opt.hh"
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace OB
+{
+// control flow graph of a decoded program, built from basic blocks
+class Cfg
+{
+public:
+  using Labels = std::map<std::string, std::size_t>;
+
+  struct Block
+  {
+    // range of program lines, end is one past the last line
+    std::size_t begin {0};
+    std::size_t end {0};
+
+    std::vector<std::size_t> succ;
+    std::vector<std::size_t> pred;
+  };
+
+  // natural loop of one or more back edges into a header
+  struct Loop
+  {
+    std::size_t header {0};
+    std::set<std::size_t> blocks;
+    std::vector<std::size_t> latches;
+  };
+
+  Cfg(Optimizer::Program const& program, Labels const& labels);
+
+  // lines that can run after line i, run also continues on the next
+  // line for when the subroutine returns, ret, ext and the last line
+  // have none
+  static std::vector<std::size_t> successors(Optimizer::Program const& program,
+    Labels const& labels, std::size_t const i);
+
+  std::vector<Block> const& blocks() const;
+  std::size_t block_of(std::size_t const line) const;
+  bool reachable(std::size_t const block) const;
+
+  // every path from the entry to block b goes through block a
+  bool dominates(std::size_t const a, std::size_t const b) const;
+
+  // innermost loops first
+  std::vector<Loop> const& loops() const;
+
+private:
+  void build_blocks(Optimizer::Program const& program, Labels const& labels);
+  void build_dominators();
+  void build_loops();
+
+  std::vector<Block> blocks_;
+  std::vector<std::size_t> block_of_;
+
+  // immediate dominator of each reachable block, the entry is its own
+  std::vector<std::size_t> idom_;
+  std::vector<std::size_t> order_;
+  std::vector<Loop> loops_;
+}; // class Cfg
+
+} // namespace OB
+
+#endif // OB_CFG_HH
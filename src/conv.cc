@@ -0,0 +1,221 @@
+#include "conv.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <locale.h>
+#include <stdlib.h>
+
+namespace OB
+{
+namespace Conv
+{
+  namespace
+  {
+    // the C locale, so a decimal point is always '.'
+    locale_t c_locale()
+    {
+      static locale_t const loc {newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0))};
+      return loc;
+    }
+
+    bool is_space(char const c)
+    {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+
+    void trim(char const*& first, char const*& last)
+    {
+      while (first != last && is_space(*first))
+      {
+        ++first;
+      }
+      while (first != last && is_space(*(last - 1)))
+      {
+        --last;
+      }
+    }
+  } // namespace
+
+  Error parse(char const* first, char const* last, std::int64_t& val)
+  {
+    trim(first, last);
+
+    bool neg {false};
+    if (first != last && (*first == '-' || *first == '+'))
+    {
+      neg = *first == '-';
+      ++first;
+    }
+    if (first == last)
+    {
+      return Error::invalid;
+    }
+
+    // magnitude of the most negative value is one more than the largest
+    std::uint64_t const max {static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) +
+      (neg ? 1u : 0u)};
+    std::uint64_t num {0};
+    bool over {false};
+    for (; first != last; ++first)
+    {
+      if (*first < '0' || *first > '9')
+      {
+        return Error::invalid;
+      }
+      auto const digit = static_cast<std::uint64_t>(*first - '0');
+      if (num > (max - digit) / 10)
+      {
+        // keep reading, a later character can still make it invalid
+        over = true;
+      }
+      else
+      {
+        num = num * 10 + digit;
+      }
+    }
+    if (over)
+    {
+      return Error::range;
+    }
+
+    val = neg ? static_cast<std::int64_t>(0 - num) : static_cast<std::int64_t>(num);
+
+    return Error::none;
+  }
+
+  Error parse(char const* first, char const* last, int& val)
+  {
+    std::int64_t num {0};
+    auto const err = parse(first, last, num);
+    if (err != Error::none)
+    {
+      return err;
+    }
+    if (num < std::numeric_limits<int>::min() || num > std::numeric_limits<int>::max())
+    {
+      return Error::range;
+    }
+
+    val = static_cast<int>(num);
+
+    return Error::none;
+  }
+
+  Error parse(char const* first, char const* last, double& val)
+  {
+    trim(first, last);
+
+    // strtod needs a terminated string, the text may be a view
+    char buf[buffer_size * 2];
+    auto const size = static_cast<std::size_t>(last - first);
+    if (size == 0)
+    {
+      return Error::invalid;
+    }
+    if (size >= sizeof(buf))
+    {
+      return Error::range;
+    }
+    std::memcpy(buf, first, size);
+    buf[size] = '\0';
+
+    char* end {nullptr};
+    errno = 0;
+    double const num {c_locale() == static_cast<locale_t>(0) ? std::strtod(buf, &end) :
+      strtod_l(buf, &end, c_locale())};
+    if (end != buf + size)
+    {
+      return Error::invalid;
+    }
+    if (errno == ERANGE)
+    {
+      return Error::range;
+    }
+
+    val = num;
+
+    return Error::none;
+  }
+
+  std::size_t write_int(char* buf, std::int64_t const val)
+  {
+    char digits[24];
+    std::size_t n {0};
+
+    auto num = static_cast<std::uint64_t>(val);
+    if (val < 0)
+    {
+      num = 0 - num;
+    }
+    do
+    {
+      digits[n++] = static_cast<char>('0' + num % 10);
+      num /= 10;
+    }
+    while (num != 0);
+
+    std::size_t size {0};
+    if (val < 0)
+    {
+      buf[size++] = '-';
+    }
+    while (n > 0)
+    {
+      buf[size++] = digits[--n];
+    }
+
+    return size;
+  }
+
+  std::size_t write_dbl(char* buf, double const val, int const decimals)
+  {
+    // printf follows the thread's locale
+    auto const loc = c_locale();
+    auto const prev = loc == static_cast<locale_t>(0) ? static_cast<locale_t>(0) : uselocale(loc);
+    int const size {std::snprintf(buf, buffer_size, "%.*f", decimals, val)};
+    if (prev != static_cast<locale_t>(0))
+    {
+      uselocale(prev);
+    }
+
+    if (size < 0)
+    {
+      return 0;
+    }
+    return std::min(static_cast<std::size_t>(size), buffer_size - 1);
+  }
+
+  void set_int(std::string& text, std::int64_t const val)
+  {
+    char buf[24];
+    text.assign(buf, write_int(buf, val));
+  }
+
+  void set_dbl(std::string& text, double const val)
+  {
+    char buf[buffer_size];
+    text.assign(buf, write_dbl(buf, val, 6));
+  }
+
+  char const* message(Error const err)
+  {
+    switch (err)
+    {
+      case Error::invalid:
+        return "value is not a number";
+
+      case Error::range:
+        return "value is out of range";
+
+      default:
+        return "";
+    }
+  }
+} // namespace Conv
+
+} // namespace OB
@@ -0,0 +1,56 @@
+#ifndef OB_CONV_HH
+#define OB_CONV_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace OB
+{
+// numbers to and from the text of int and dbl values, the same in every
+// locale, nothing throws and only a growing string allocates
+namespace Conv
+{
+  enum class Error
+  {
+    none,
+
+    // not a number of the type, or other characters after it
+    invalid,
+
+    // a number too large or too small for the type
+    range,
+  };
+
+  // chars that fit any int or dbl written with up to six decimals
+  constexpr std::size_t buffer_size {320};
+
+  // parses all of [first, last), whitespace around the number is ignored,
+  // val is only written when the result is Error::none
+  Error parse(char const* first, char const* last, int& val);
+  Error parse(char const* first, char const* last, std::int64_t& val);
+  Error parse(char const* first, char const* last, double& val);
+
+  template<typename T>
+  Error parse(std::string const& text, T& val)
+  {
+    return parse(text.data(), text.data() + text.size(), val);
+  }
+
+  // writes val to buf of buffer_size chars, returns the length,
+  // dbls like printf with %.*f and decimals
+  std::size_t write_int(char* buf, std::int64_t const val);
+  std::size_t write_dbl(char* buf, double const val, int const decimals);
+
+  // replaces text with val in place, dbls with the six decimals
+  // a value holds, as std::to_string writes them
+  void set_int(std::string& text, std::int64_t const val);
+  void set_dbl(std::string& text, double const val);
+
+  // the error reported to the script
+  char const* message(Error const err);
+} // namespace Conv
+
+} // namespace OB
+
+#endif // OB_CONV_HH
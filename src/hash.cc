@@ -0,0 +1,127 @@
+#include "hash.hh"
+
+#include <functional>
+#include <utility>
+
+namespace OB
+{
+  namespace
+  {
+    // a power of two so a hash is reduced with a mask
+    constexpr std::size_t initial {8};
+  } // namespace
+
+  Map::Map() :
+    slots_(initial)
+  {
+  }
+
+  std::size_t Map::size() const
+  {
+    return size_;
+  }
+
+  std::size_t Map::probe(std::string const& key, std::size_t const hash) const
+  {
+    auto const mask = slots_.size() - 1;
+    auto i = hash & mask;
+    auto first = slots_.size();
+
+    // reserve keeps an empty slot, so the probe ends
+    for (;;)
+    {
+      auto const& slot = slots_.at(i);
+      if (slot.state == State::empty)
+      {
+        return first == slots_.size() ? i : first;
+      }
+      if (slot.state == State::removed)
+      {
+        if (first == slots_.size())
+        {
+          first = i;
+        }
+      }
+      else if (slot.hash == hash && slot.key == key)
+      {
+        return i;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+  Map::Value const* Map::find(std::string const& key) const
+  {
+    auto const& slot = slots_.at(probe(key, std::hash<std::string>{}(key)));
+    if (slot.state != State::full)
+    {
+      return nullptr;
+    }
+    return &slot.val;
+  }
+
+  void Map::insert(std::string const& key, Value val)
+  {
+    reserve();
+
+    auto const hash = std::hash<std::string>{}(key);
+    auto& slot = slots_.at(probe(key, hash));
+    if (slot.state != State::full)
+    {
+      if (slot.state == State::empty)
+      {
+        ++used_;
+      }
+      ++size_;
+      slot.state = State::full;
+      slot.hash = hash;
+      slot.key = key;
+    }
+    slot.val = std::move(val);
+  }
+
+  bool Map::erase(std::string const& key)
+  {
+    auto& slot = slots_.at(probe(key, std::hash<std::string>{}(key)));
+    if (slot.state != State::full)
+    {
+      return false;
+    }
+
+    slot.state = State::removed;
+    slot.key.clear();
+    slot.val = Value();
+    --size_;
+
+    return true;
+  }
+
+  void Map::reserve()
+  {
+    if ((used_ + 1) * 4 <= slots_.size() * 3)
+    {
+      return;
+    }
+
+    // only grow when live keys fill the table, otherwise clear the markers
+    auto const count = (size_ + 1) * 2 > slots_.size() ? slots_.size() * 2 : slots_.size();
+    std::vector<Slot> slots(count);
+    std::swap(slots, slots_);
+    used_ = size_;
+
+    auto const mask = slots_.size() - 1;
+    for (auto& e : slots)
+    {
+      if (e.state != State::full)
+      {
+        continue;
+      }
+      auto i = e.hash & mask;
+      while (slots_.at(i).state != State::empty)
+      {
+        i = (i + 1) & mask;
+      }
+      slots_.at(i) = std::move(e);
+    }
+  }
+} // namespace OB
@@ -0,0 +1,65 @@
+#ifndef OB_HASH_HH
+#define OB_HASH_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace OB
+{
+// keys to values in one open addressed table, held by a value of type 'map',
+// slots are probed linearly and removed keys leave a marker until the
+// table is rebuilt
+class Map
+{
+public:
+  // stored value, the type and text of an int, dbl or str
+  struct Value
+  {
+    std::string type;
+    std::string value;
+  };
+
+  Map();
+
+  std::size_t size() const;
+
+  // keys are compared as given, the caller makes equal keys equal text
+  // nullptr if the key is not present
+  Value const* find(std::string const& key) const;
+
+  void insert(std::string const& key, Value val);
+
+  // returns false if the key was not present
+  bool erase(std::string const& key);
+
+private:
+  enum class State
+  {
+    empty,
+    full,
+    removed,
+  };
+
+  struct Slot
+  {
+    State state {State::empty};
+    std::size_t hash {0};
+    std::string key;
+    Value val;
+  };
+
+  // slot holding the key, or the first one it could go in
+  std::size_t probe(std::string const& key, std::size_t const hash) const;
+
+  // doubles the slots when full and removed ones pass three quarters
+  void reserve();
+
+  std::vector<Slot> slots_;
+  std::size_t size_ {0};
+  std::size_t used_ {0};
+}; // class Map
+
+} // namespace OB
+
+#endif // OB_HASH_HH
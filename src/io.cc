@@ -0,0 +1,308 @@
+#include "io.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace OB
+{
+  Mmap::Mmap(std::string const& file)
+  {
+    int fd {::open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (fd < 0)
+    {
+      return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      auto const size = static_cast<std::size_t>(st.st_size);
+      void* ptr {::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+      if (ptr != MAP_FAILED)
+      {
+        data_ = static_cast<char const*>(ptr);
+        size_ = size;
+        dev_ = static_cast<std::uint64_t>(st.st_dev);
+        ino_ = static_cast<std::uint64_t>(st.st_ino);
+      }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+  }
+
+  Mmap::~Mmap()
+  {
+    if (data_ != nullptr)
+    {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  bool Mmap::is_open() const
+  {
+    return data_ != nullptr;
+  }
+
+  char const* Mmap::data() const
+  {
+    return data_;
+  }
+
+  std::size_t Mmap::size() const
+  {
+    return size_;
+  }
+
+  bool Mmap::maps(std::string const& file) const
+  {
+    if (data_ == nullptr || ino_ == 0)
+    {
+      return false;
+    }
+
+    struct stat st;
+    if (::stat(file.c_str(), &st) != 0)
+    {
+      return false;
+    }
+    return static_cast<std::uint64_t>(st.st_dev) == dev_ && static_cast<std::uint64_t>(st.st_ino) == ino_;
+  }
+
+  bool Mmap::detach()
+  {
+    if (data_ == nullptr || ino_ == 0)
+    {
+      return true;
+    }
+
+    void* ptr {::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (ptr == MAP_FAILED)
+    {
+      return false;
+    }
+    std::memcpy(ptr, data_, size_);
+    ::mprotect(ptr, size_, PROT_READ);
+
+    // replaces the file pages in place, pointers into them stay valid
+    if (::mremap(ptr, size_, size_, MREMAP_MAYMOVE | MREMAP_FIXED, const_cast<char*>(data_)) == MAP_FAILED)
+    {
+      ::munmap(ptr, size_);
+      return false;
+    }
+
+    dev_ = 0;
+    ino_ = 0;
+    return true;
+  }
+
+  Reader::Reader(std::string const& file) :
+    fd_ {::open(file.c_str(), O_RDONLY | O_CLOEXEC)}
+  {
+    if (fd_ >= 0)
+    {
+      // one large buffer per handle, reused for every line
+      buf_.resize(1 << 20);
+      ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+  }
+
+  Reader::Reader(int const fd) :
+    fd_ {fd},
+    own_ {false}
+  {
+    if (fd_ >= 0)
+    {
+      buf_.resize(1 << 20);
+    }
+  }
+
+  Reader::~Reader()
+  {
+    close();
+  }
+
+  bool Reader::is_open() const
+  {
+    return fd_ >= 0;
+  }
+
+  bool Reader::getline(std::string& line)
+  {
+    line.clear();
+    if (fd_ < 0)
+    {
+      return false;
+    }
+
+    bool found {false};
+    for (;;)
+    {
+      if (pos_ == end_)
+      {
+        if (fill() == 0)
+        {
+          // a final line without a newline still counts,
+          // unless the read that would have ended it failed
+          return found && ! err_;
+        }
+      }
+      found = true;
+
+      auto const begin = buf_.data() + pos_;
+      auto const nl = static_cast<char const*>(std::memchr(begin, '\n', end_ - pos_));
+      if (nl != nullptr)
+      {
+        line.append(begin, static_cast<std::size_t>(nl - begin));
+        pos_ += static_cast<std::size_t>(nl - begin) + 1;
+        return true;
+      }
+
+      line.append(begin, end_ - pos_);
+      pos_ = end_;
+    }
+  }
+
+  bool Reader::error() const
+  {
+    return err_;
+  }
+
+  void Reader::close()
+  {
+    if (fd_ >= 0 && own_)
+    {
+      ::close(fd_);
+    }
+    fd_ = -1;
+    pos_ = end_ = 0;
+  }
+
+  std::size_t Reader::fill()
+  {
+    pos_ = end_ = 0;
+    for (;;)
+    {
+      auto const n = ::read(fd_, buf_.data(), buf_.size());
+      if (n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (n < 0)
+      {
+        err_ = true;
+        return 0;
+      }
+      if (n == 0)
+      {
+        return 0;
+      }
+      end_ = static_cast<std::size_t>(n);
+      return end_;
+    }
+  }
+
+  Writer::Writer(std::string const& file, bool const append, std::size_t const buffer) :
+    fd_ {::open(file.c_str(),
+      O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666)}
+  {
+    if (fd_ >= 0)
+    {
+      buf_.resize(buffer);
+    }
+  }
+
+  Writer::~Writer()
+  {
+    close();
+  }
+
+  bool Writer::is_open() const
+  {
+    return fd_ >= 0;
+  }
+
+  bool Writer::write(char const* data, std::size_t size)
+  {
+    if (fd_ < 0)
+    {
+      return false;
+    }
+    if (size == 0)
+    {
+      return true;
+    }
+
+    if (end_ + size > buf_.size())
+    {
+      if (! flush())
+      {
+        return false;
+      }
+
+      // large writes skip the buffer
+      if (size >= buf_.size())
+      {
+        return write_all(data, size);
+      }
+    }
+
+    std::memcpy(buf_.data() + end_, data, size);
+    end_ += size;
+
+    return true;
+  }
+
+  bool Writer::flush()
+  {
+    if (fd_ < 0)
+    {
+      return false;
+    }
+
+    auto const size = end_;
+    end_ = 0;
+
+    return write_all(buf_.data(), size);
+  }
+
+  bool Writer::close()
+  {
+    if (fd_ < 0)
+    {
+      return true;
+    }
+
+    bool const status {flush()};
+    ::close(fd_);
+    fd_ = -1;
+
+    return status;
+  }
+
+  bool Writer::write_all(char const* data, std::size_t size)
+  {
+    while (size > 0)
+    {
+      auto const n = ::write(fd_, data, size);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return false;
+      }
+      data += n;
+      size -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+  }
+} // namespace OB
@@ -0,0 +1,110 @@
+#ifndef OB_IO_HH
+#define OB_IO_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace OB
+{
+class Mmap
+{
+public:
+  Mmap(std::string const& file);
+  ~Mmap();
+
+  Mmap(Mmap const&) = delete;
+  Mmap& operator=(Mmap const&) = delete;
+
+  // false if the file could not be opened, is not a regular file, or is empty
+  bool is_open() const;
+
+  char const* data() const;
+  std::size_t size() const;
+
+  // true while the bytes are those of file as it was mapped
+  bool maps(std::string const& file) const;
+
+  // moves the bytes into memory of their own at the same address, so
+  // truncating the file can't take them from the values viewing them,
+  // returns false if they could not be moved
+  bool detach();
+
+private:
+  char const* data_ {nullptr};
+  std::size_t size_ {0};
+
+  // identity of the mapped file, both 0 once detached
+  std::uint64_t dev_ {0};
+  std::uint64_t ino_ {0};
+}; // class Mmap
+
+class Reader
+{
+public:
+  Reader(std::string const& file);
+
+  // reads from an already open descriptor without taking ownership
+  explicit Reader(int const fd);
+
+  ~Reader();
+
+  Reader(Reader const&) = delete;
+  Reader& operator=(Reader const&) = delete;
+
+  bool is_open() const;
+
+  // reads the next line into line without the trailing newline
+  // returns false at the end of the file or once a read failed
+  bool getline(std::string& line);
+
+  // true once a read failed, as opposed to reaching the end of the file
+  bool error() const;
+
+  void close();
+
+private:
+  // refills the buffer, returns the number of bytes read,
+  // 0 at the end of the file or on an error
+  std::size_t fill();
+
+  int fd_ {-1};
+  bool own_ {true};
+  bool err_ {false};
+  std::vector<char> buf_;
+  std::size_t pos_ {0};
+  std::size_t end_ {0};
+}; // class Reader
+
+class Writer
+{
+public:
+  // a buffer size of 0 writes straight through
+  Writer(std::string const& file, bool const append, std::size_t const buffer = 1 << 20);
+
+  // flushes any buffered bytes
+  ~Writer();
+
+  Writer(Writer const&) = delete;
+  Writer& operator=(Writer const&) = delete;
+
+  bool is_open() const;
+
+  // returns false if the bytes could not be written
+  bool write(char const* data, std::size_t size);
+  bool flush();
+
+  bool close();
+
+private:
+  bool write_all(char const* data, std::size_t size);
+
+  int fd_ {-1};
+  std::vector<char> buf_;
+  std::size_t end_ {0};
+}; // class Writer
+
+} // namespace OB
+
+#endif // OB_IO_HH
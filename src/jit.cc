@@ -0,0 +1,735 @@
+#include "jit.hh"
+#include "conv.hh"
+
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if PINE_JIT && defined(__x86_64__) && defined(__linux__)
+#define OB_JIT_NATIVE 1
+#include <sys/mman.h>
+#else
+#define OB_JIT_NATIVE 0
+#endif
+
+namespace OB
+{
+  constexpr std::int64_t Jit::Block::untouched;
+  constexpr std::int64_t Jit::Block::integer;
+  constexpr std::int64_t Jit::Block::real;
+  constexpr std::size_t Jit::threshold;
+
+  namespace
+  {
+    // offsets into the frame
+    constexpr std::int32_t off_count {0};
+    constexpr std::int32_t off_jumps {8};
+    constexpr std::int32_t off_cmp {16};
+
+    std::int32_t off_value(std::size_t const slot)
+    {
+      return static_cast<std::int32_t>(24 + 16 * slot);
+    }
+
+    std::int32_t off_tag(std::size_t const slot)
+    {
+      return static_cast<std::int32_t>(32 + 16 * slot);
+    }
+
+    // a dbl result is stored as text with six decimals in the interpreter,
+    // round it the same way so the next instruction sees the same value
+    double round_dbl(double const val)
+    {
+      char buf[Conv::buffer_size];
+      double res {val};
+      Conv::parse(buf, buf + Conv::write_dbl(buf, val, 6), res);
+      return res;
+    }
+
+    double remainder_dbl(double const lhs, double const rhs)
+    {
+      return round_dbl(std::remainder(lhs, rhs));
+    }
+
+    // emits x86-64, every memory operand is a 32 bit displacement from rbx
+    class Asm
+    {
+    public:
+      std::vector<std::uint8_t> code;
+
+      void byte(std::uint8_t const val)
+      {
+        code.emplace_back(val);
+      }
+
+      void bytes(std::initializer_list<std::uint8_t> const val)
+      {
+        code.insert(code.end(), val.begin(), val.end());
+      }
+
+      void dword(std::uint32_t const val)
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          byte(static_cast<std::uint8_t>(val >> (8 * i)));
+        }
+      }
+
+      void qword(std::uint64_t const val)
+      {
+        for (int i = 0; i < 8; ++i)
+        {
+          byte(static_cast<std::uint8_t>(val >> (8 * i)));
+        }
+      }
+
+      // modrm for reg and [rbx + disp32]
+      void mem(std::uint8_t const reg, std::int32_t const disp)
+      {
+        byte(static_cast<std::uint8_t>(0x80 | (reg << 3) | 3));
+        dword(static_cast<std::uint32_t>(disp));
+      }
+
+      std::size_t here() const
+      {
+        return code.size();
+      }
+
+      // jump with a rel32 to patch, cc 0 for jmp
+      std::size_t jump(std::uint8_t const cc)
+      {
+        if (cc == 0)
+        {
+          byte(0xE9);
+        }
+        else
+        {
+          bytes({0x0F, cc});
+        }
+        dword(0);
+        return here() - 4;
+      }
+
+      void patch(std::size_t const at, std::size_t const target)
+      {
+        auto const rel = static_cast<std::uint32_t>(static_cast<std::int64_t>(target) -
+          static_cast<std::int64_t>(at + 4));
+        for (int i = 0; i < 4; ++i)
+        {
+          code.at(at + static_cast<std::size_t>(i)) = static_cast<std::uint8_t>(rel >> (8 * i));
+        }
+      }
+
+      // rax = fn, call rax
+      void call(void const* fn)
+      {
+        bytes({0x48, 0xB8});
+        qword(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(fn)));
+        bytes({0xFF, 0xD0});
+      }
+    };
+
+    // condition codes of jcc rel32
+    constexpr std::uint8_t cc_o {0x80};
+    constexpr std::uint8_t cc_e {0x84};
+    constexpr std::uint8_t cc_ne {0x85};
+    constexpr std::uint8_t cc_l {0x8C};
+    constexpr std::uint8_t cc_ge {0x8D};
+    constexpr std::uint8_t cc_le {0x8E};
+    constexpr std::uint8_t cc_g {0x8F};
+
+    // jcc that skips a branch on the cmp flag when it is not taken
+    std::uint8_t skip(std::string const& cond)
+    {
+      if (cond == "eq") return cc_ne;
+      if (cond == "ne") return cc_e;
+      if (cond == "lt") return cc_ge;
+      if (cond == "gt") return cc_le;
+      if (cond == "ge") return cc_l;
+      return cc_g;
+    }
+  } // namespace
+
+  Jit::Block::Block(std::vector<Var> vars, std::vector<Exit> exits, std::vector<Literal> literals) :
+    vars_ {std::move(vars)},
+    exits_ {std::move(exits)},
+    literals_ {std::move(literals)},
+    frame_(3 + 2 * vars_.size(), 0)
+  {
+  }
+
+  Jit::Block::~Block()
+  {
+#if OB_JIT_NATIVE
+    if (code_)
+    {
+      munmap(code_, size_);
+    }
+#endif
+  }
+
+  std::vector<Jit::Var> const& Jit::Block::vars() const
+  {
+    return vars_;
+  }
+
+  void Jit::Block::set_int(std::size_t const slot, std::int64_t const val)
+  {
+    frame_.at(3 + 2 * slot) = val;
+  }
+
+  void Jit::Block::set_dbl(std::size_t const slot, double const val)
+  {
+    std::memcpy(&frame_.at(3 + 2 * slot), &val, sizeof(val));
+  }
+
+  std::int64_t Jit::Block::get_int(std::size_t const slot) const
+  {
+    return frame_.at(3 + 2 * slot);
+  }
+
+  double Jit::Block::get_dbl(std::size_t const slot) const
+  {
+    double val {0};
+    std::memcpy(&val, &frame_.at(3 + 2 * slot), sizeof(val));
+    return val;
+  }
+
+  std::int64_t Jit::Block::tag(std::size_t const slot) const
+  {
+    return frame_.at(4 + 2 * slot);
+  }
+
+  Jit::Literal const& Jit::Block::literal(std::int64_t const index) const
+  {
+    return literals_.at(static_cast<std::size_t>(index));
+  }
+
+  Jit::Exit const& Jit::Block::run(int const cmp)
+  {
+    frame_.at(0) = 0;
+    frame_.at(1) = 0;
+    frame_.at(2) = cmp;
+    for (std::size_t i = 0; i < vars_.size(); ++i)
+    {
+      frame_.at(4 + 2 * i) = untouched;
+    }
+
+    int exit {0};
+#if OB_JIT_NATIVE
+    using Fn = int (*)(std::int64_t*);
+    exit = reinterpret_cast<Fn>(code_)(frame_.data());
+#endif
+
+    return exits_.at(static_cast<std::size_t>(exit));
+  }
+
+  std::uint64_t Jit::Block::count() const
+  {
+    return static_cast<std::uint64_t>(frame_.at(0));
+  }
+
+  std::uint64_t Jit::Block::jumps() const
+  {
+    return static_cast<std::uint64_t>(frame_.at(1));
+  }
+
+  int Jit::Block::cmp() const
+  {
+    std::int32_t val {0};
+    std::memcpy(&val, &frame_.at(2), sizeof(val));
+    return val;
+  }
+
+  Jit::Jit(Optimizer::Program program, bool const checked) :
+    program_ {std::move(program)},
+    checked_ {checked}
+  {
+  }
+
+  bool Jit::supported()
+  {
+    return OB_JIT_NATIVE != 0;
+  }
+
+  Jit::Block* Jit::enter(int const line, std::function<Type(std::string const&)> const& type_of)
+  {
+    auto& e = entries_[line];
+    if (e.block)
+    {
+      return e.block.get();
+    }
+    if (e.failed || ++e.count < threshold)
+    {
+      return nullptr;
+    }
+
+    e.block = compile(line, type_of);
+    ++e.compiles;
+    if (! e.block)
+    {
+      e.failed = true;
+    }
+
+    return e.block.get();
+  }
+
+  void Jit::miss(int const line)
+  {
+    // values changed type, compile again with the new ones, a few times
+    auto& e = entries_[line];
+    if (++e.misses < threshold)
+    {
+      return;
+    }
+
+    e.block.reset();
+    e.misses = 0;
+    e.count = 0;
+    if (e.compiles >= 4)
+    {
+      e.failed = true;
+    }
+  }
+
+  std::unique_ptr<Jit::Block> Jit::compile(int const line,
+    std::function<Type(std::string const&)> const& type_of) const
+  {
+#if OB_JIT_NATIVE
+    auto const begin = static_cast<std::size_t>(line);
+    if (begin < 1 || begin > program_.size() || ! program_.at(begin - 1).is_ins() ||
+      program_.at(begin - 1).op() != "lbl")
+    {
+      return nullptr;
+    }
+    std::string const label {program_.at(begin - 1).args.at(1)};
+
+    std::vector<Var> vars;
+    std::vector<Type> types;
+    std::map<std::string, std::size_t> slots;
+    std::vector<Exit> exits;
+    std::vector<Literal> literals;
+    std::size_t compiled {0};
+
+    Asm a;
+
+    // push rbx, mov rbx rdi
+    a.bytes({0x53, 0x48, 0x89, 0xFB});
+    auto const top = a.here();
+
+    // exits jump to the epilogue with their index in eax
+    std::vector<std::size_t> to_epilogue;
+    auto const leave = [&](int const after, std::string const& jump)
+    {
+      exits.push_back({after, jump});
+      a.byte(0xB8);
+      a.dword(static_cast<std::uint32_t>(exits.size() - 1));
+      to_epilogue.emplace_back(a.jump(0));
+    };
+
+    // deopt stubs are placed after the code, they resume before the line
+    std::vector<std::pair<std::size_t, int>> stubs;
+
+    // a variable read by the block, its type on entry comes from the interpreter
+    auto const read = [&](std::string const& name, std::size_t& slot)
+    {
+      auto const it = slots.find(name);
+      if (it != slots.end())
+      {
+        slot = it->second;
+        return types.at(slot) != Type::none;
+      }
+      auto const type = type_of(name);
+      if (type == Type::none)
+      {
+        return false;
+      }
+      slot = vars.size();
+      slots[name] = slot;
+      vars.push_back({name, type, true});
+      types.emplace_back(type);
+      return true;
+    };
+
+    auto const write = [&](std::string const& name, Type const type)
+    {
+      auto const it = slots.find(name);
+      if (it != slots.end())
+      {
+        types.at(it->second) = type;
+        return it->second;
+      }
+      auto const slot = vars.size();
+      slots[name] = slot;
+      vars.push_back({name, Type::none, false});
+      types.emplace_back(type);
+      return slot;
+    };
+
+    auto const count = [&]()
+    {
+      // add qword [count], 1
+      a.bytes({0x48, 0x83});
+      a.mem(0, off_count);
+      a.byte(1);
+      ++compiled;
+    };
+
+    auto const store_tag = [&](std::size_t const slot, std::int64_t const tag)
+    {
+      // mov qword [tag], imm32
+      a.bytes({0x48, 0xC7});
+      a.mem(0, off_tag(slot));
+      a.dword(static_cast<std::uint32_t>(tag));
+    };
+
+    // add, sub, mlt, div and mod of two variables of the same type
+    auto const arith = [&](std::string const& op, std::string const& lhs,
+      std::string const& rhs, int const ln, bool const counts)
+    {
+      std::size_t x {0};
+      std::size_t y {0};
+      if (! read(lhs, x) || ! read(rhs, y) || types.at(x) != types.at(y))
+      {
+        return false;
+      }
+
+      if (types.at(x) == Type::integer)
+      {
+        if (op == "div" || op == "mod")
+        {
+          // a trap is left to the interpreter, mov rcx [y], test rcx rcx
+          a.bytes({0x48, 0x8B});
+          a.mem(1, off_value(y));
+          a.bytes({0x48, 0x85, 0xC9});
+          stubs.emplace_back(a.jump(cc_e), ln);
+          // cmp rcx -1, jne, mov rax int min, cmp [x] rax, je
+          a.bytes({0x48, 0x83, 0xF9, 0xFF});
+          auto const ok = a.jump(cc_ne);
+          a.bytes({0x48, 0xB8});
+          a.qword(0x8000000000000000u);
+          a.bytes({0x48, 0x39});
+          a.mem(0, off_value(x));
+          stubs.emplace_back(a.jump(cc_e), ln);
+          a.patch(ok, a.here());
+
+          if (counts)
+          {
+            count();
+          }
+          // mov rax [x], cqo, idiv rcx, mov [x] rax or rdx
+          a.bytes({0x48, 0x8B});
+          a.mem(0, off_value(x));
+          a.bytes({0x48, 0x99, 0x48, 0xF7, 0xF9});
+          a.bytes({0x48, 0x89});
+          a.mem(op == "div" ? 0 : 2, off_value(x));
+        }
+        else
+        {
+          // mov rax [x], add, sub or imul rax [y]
+          a.bytes({0x48, 0x8B});
+          a.mem(0, off_value(x));
+          if (op == "add")
+          {
+            a.bytes({0x48, 0x03});
+          }
+          else if (op == "sub")
+          {
+            a.bytes({0x48, 0x2B});
+          }
+          else
+          {
+            a.bytes({0x48, 0x0F, 0xAF});
+          }
+          a.mem(0, off_value(y));
+          if (checked_)
+          {
+            // the interpreter reports the overflow, nothing is stored yet
+            stubs.emplace_back(a.jump(cc_o), ln);
+          }
+
+          if (counts)
+          {
+            count();
+          }
+          // mov [x] rax
+          a.bytes({0x48, 0x89});
+          a.mem(0, off_value(x));
+        }
+        store_tag(x, Block::integer);
+      }
+      else
+      {
+        if (counts)
+        {
+          count();
+        }
+        // movsd xmm0 [x]
+        a.bytes({0xF2, 0x0F, 0x10});
+        a.mem(0, off_value(x));
+        if (op == "mod")
+        {
+          // movsd xmm1 [y]
+          a.bytes({0xF2, 0x0F, 0x10});
+          a.mem(1, off_value(y));
+          a.call(reinterpret_cast<void const*>(&remainder_dbl));
+        }
+        else
+        {
+          std::uint8_t const code {op == "add" ? std::uint8_t {0x58} : op == "sub" ?
+            std::uint8_t {0x5C} : op == "mlt" ? std::uint8_t {0x59} : std::uint8_t {0x5E}};
+          a.bytes({0xF2, 0x0F, code});
+          a.mem(0, off_value(y));
+          a.call(reinterpret_cast<void const*>(&round_dbl));
+        }
+        // movsd [x] xmm0
+        a.bytes({0xF2, 0x0F, 0x11});
+        a.mem(0, off_value(x));
+        store_tag(x, Block::real);
+      }
+
+      return true;
+    };
+
+    auto const compare = [&](std::string const& lhs, std::string const& rhs, bool const counts)
+    {
+      std::size_t x {0};
+      std::size_t y {0};
+      if (! read(lhs, x) || ! read(rhs, y) || types.at(x) != types.at(y))
+      {
+        return false;
+      }
+
+      if (counts)
+      {
+        count();
+      }
+      if (types.at(x) == Type::integer)
+      {
+        // mov rax [x], cmp rax [y], setg al, setl dl
+        a.bytes({0x48, 0x8B});
+        a.mem(0, off_value(x));
+        a.bytes({0x48, 0x3B});
+        a.mem(0, off_value(y));
+        a.bytes({0x0F, 0x9F, 0xC0, 0x0F, 0x9C, 0xC2});
+      }
+      else
+      {
+        // unordered compares equal, movsd xmm0 [x], ucomisd xmm0 [y], seta al,
+        // movsd xmm1 [y], ucomisd xmm1 [x], seta dl
+        a.bytes({0xF2, 0x0F, 0x10});
+        a.mem(0, off_value(x));
+        a.bytes({0x66, 0x0F, 0x2E});
+        a.mem(0, off_value(y));
+        a.bytes({0x0F, 0x97, 0xC0});
+        a.bytes({0xF2, 0x0F, 0x10});
+        a.mem(1, off_value(y));
+        a.bytes({0x66, 0x0F, 0x2E});
+        a.mem(1, off_value(x));
+        a.bytes({0x0F, 0x97, 0xC2});
+      }
+      // movzx eax al, movzx edx dl, sub eax edx, mov [cmp] eax
+      a.bytes({0x0F, 0xB6, 0xC0, 0x0F, 0xB6, 0xD2, 0x29, 0xD0});
+      a.byte(0x89);
+      a.mem(0, off_cmp);
+
+      return true;
+    };
+
+    // a taken jump loops when it goes back to the label with the
+    // types the block was entered with, anything else leaves
+    auto const branch = [&](std::string const& target, int const ln)
+    {
+      // add qword [jumps], 1
+      a.bytes({0x48, 0x83});
+      a.mem(0, off_jumps);
+      a.byte(1);
+
+      bool stable {target == label && static_cast<std::size_t>(ln) < program_.size()};
+      for (std::size_t i = 0; stable && i < vars.size(); ++i)
+      {
+        stable = ! vars.at(i).input || types.at(i) == vars.at(i).type;
+      }
+      if (stable)
+      {
+        a.patch(a.jump(0), top);
+      }
+      else
+      {
+        leave(ln, target);
+      }
+    };
+
+    std::size_t i {begin};
+    for (; i < program_.size(); ++i)
+    {
+      auto const& e = program_.at(i);
+      int const ln {static_cast<int>(i) + 1};
+      if (! e.is_ins())
+      {
+        continue;
+      }
+
+      auto const& op = e.op();
+      bool ok {true};
+      if (op == "mov")
+      {
+        auto const& val = e.args.at(2);
+        Literal lit;
+        if (val.at(0) == '\'' && val.at(val.size() - 1) == '\'')
+        {
+          ok = false;
+        }
+        else if (val.at(val.size() - 1) == 'f')
+        {
+          lit = {Type::real, val.substr(0, val.size() - 1)};
+
+          // a literal the interpreter can't read is left to it
+          double num {0};
+          ok = Conv::parse(lit.value, num) == Conv::Error::none;
+          if (ok)
+          {
+            auto const slot = write(e.args.at(1), Type::real);
+            count();
+            std::uint64_t bits {0};
+            std::memcpy(&bits, &num, sizeof(num));
+            // mov rax imm64, mov [x] rax
+            a.bytes({0x48, 0xB8});
+            a.qword(bits);
+            a.byte(0x48);
+            a.byte(0x89);
+            a.mem(0, off_value(slot));
+            literals.emplace_back(lit);
+            store_tag(slot, static_cast<std::int64_t>(literals.size() - 1));
+          }
+        }
+        else
+        {
+          lit = {Type::integer, val};
+          std::int64_t num {0};
+          ok = Conv::parse(lit.value, num) == Conv::Error::none;
+          if (ok)
+          {
+            auto const slot = write(e.args.at(1), Type::integer);
+            count();
+            // mov rax imm64, mov [x] rax
+            a.bytes({0x48, 0xB8});
+            a.qword(static_cast<std::uint64_t>(num));
+            a.byte(0x48);
+            a.byte(0x89);
+            a.mem(0, off_value(slot));
+            literals.emplace_back(lit);
+            store_tag(slot, static_cast<std::int64_t>(literals.size() - 1));
+          }
+        }
+      }
+      else if (op == "add" || op == "sub" || op == "mlt" || op == "div" || op == "mod")
+      {
+        ok = arith(op, e.args.at(1), e.args.at(2), ln, true);
+      }
+      else if (op == "cmp")
+      {
+        ok = compare(e.args.at(1), e.args.at(2), true);
+      }
+      else if (op == "jmp")
+      {
+        count();
+        branch(e.args.at(1), ln);
+        break;
+      }
+      else if (op == "jeq" || op == "jne" || op == "jlt" || op == "jgt" || op == "jge" || op == "jle")
+      {
+        count();
+        // cmp dword [cmp] 0
+        a.byte(0x83);
+        a.mem(7, off_cmp);
+        a.byte(0);
+        auto const not_taken = a.jump(skip(op.substr(1)));
+        branch(e.args.at(1), ln);
+        a.patch(not_taken, a.here());
+      }
+      else if (op == "itr")
+      {
+        // check every type first, nothing may run twice when it hands back
+        std::size_t v {0};
+        std::size_t step {0};
+        std::size_t limit {0};
+        ok = read(e.args.at(2), v) && read(e.args.at(3), step) && read(e.args.at(4), limit) &&
+          types.at(v) == types.at(step) && types.at(v) == types.at(limit);
+        if (ok)
+        {
+          // one instruction for the add, cmp and jump, counted after
+          // the add so an overflow hands it back uncounted
+          arith("add", e.args.at(2), e.args.at(3), ln, false);
+          count();
+          compare(e.args.at(2), e.args.at(4), false);
+          a.byte(0x83);
+          a.mem(7, off_cmp);
+          a.byte(0);
+          auto const not_taken = a.jump(skip(e.args.at(1)));
+          branch(e.args.at(5), ln);
+          a.patch(not_taken, a.here());
+        }
+      }
+      else
+      {
+        ok = false;
+      }
+
+      if (! ok)
+      {
+        // the interpreter takes over at this line
+        leave(ln - 1, {});
+        break;
+      }
+    }
+
+    if (i == program_.size())
+    {
+      leave(static_cast<int>(program_.size()), {});
+    }
+
+    for (auto const& e : stubs)
+    {
+      a.patch(e.first, a.here());
+      leave(e.second - 1, {});
+    }
+
+    // pop rbx, ret
+    auto const epilogue = a.here();
+    a.bytes({0x5B, 0xC3});
+    for (auto const e : to_epilogue)
+    {
+      a.patch(e, epilogue);
+    }
+
+    // nothing ran natively before handing back
+    if (compiled == 0)
+    {
+      return nullptr;
+    }
+
+    auto block = std::make_unique<Block>(std::move(vars), std::move(exits), std::move(literals));
+    block->size_ = a.code.size();
+    void* mem {mmap(nullptr, block->size_, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (mem == MAP_FAILED)
+    {
+      return nullptr;
+    }
+    std::memcpy(mem, a.code.data(), a.code.size());
+    if (mprotect(mem, block->size_, PROT_READ | PROT_EXEC) != 0)
+    {
+      munmap(mem, block->size_);
+      return nullptr;
+    }
+    block->code_ = mem;
+
+    return block;
+#else
+    static_cast<void>(line);
+    static_cast<void>(type_of);
+    return nullptr;
+#endif
+  }
+} // namespace OB
@@ -0,0 +1,139 @@
+#ifndef OB_JIT_HH
+#define OB_JIT_HH
+
+#include "opt.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace OB
+{
+// compiles the straight line code after a hot label to x86-64,
+// the code runs until it leaves the line range, reaches an instruction
+// it can't run or a value changes type, then hands back to the interpreter
+class Jit
+{
+public:
+  enum class Type
+  {
+    none,
+    integer,
+    real,
+  };
+
+  // variable used by a block, inputs are read before they are written
+  // and must hold their type when the block is entered
+  struct Var
+  {
+    std::string name;
+    Type type {Type::none};
+    bool input {false};
+  };
+
+  // value stored by a mov, kept as text so it is written back as written
+  struct Literal
+  {
+    Type type {Type::none};
+    std::string value;
+  };
+
+  // where the interpreter resumes, after the line and then
+  // jumping to the label when it is not empty
+  struct Exit
+  {
+    int line {0};
+    std::string jump;
+  };
+
+  class Block
+  {
+  public:
+    // tags of a variable, untouched ones keep their value, computed
+    // ones are written back from the slot and moved ones from the literal
+    static constexpr std::int64_t untouched {-1};
+    static constexpr std::int64_t integer {-2};
+    static constexpr std::int64_t real {-3};
+
+    Block(std::vector<Var> vars, std::vector<Exit> exits, std::vector<Literal> literals);
+    ~Block();
+
+    Block(Block const&) = delete;
+    Block& operator=(Block const&) = delete;
+
+    std::vector<Var> const& vars() const;
+
+    void set_int(std::size_t const slot, std::int64_t const val);
+    void set_dbl(std::size_t const slot, double const val);
+    std::int64_t get_int(std::size_t const slot) const;
+    double get_dbl(std::size_t const slot) const;
+
+    // untouched, integer, real or the index of a literal
+    std::int64_t tag(std::size_t const slot) const;
+    Literal const& literal(std::int64_t const index) const;
+
+    // runs the block with the cmp flag, returns the exit taken
+    Exit const& run(int const cmp);
+
+    // instructions executed, jumps taken and the cmp flag of the last run
+    std::uint64_t count() const;
+    std::uint64_t jumps() const;
+    int cmp() const;
+
+  private:
+    friend class Jit;
+
+    std::vector<Var> vars_;
+    std::vector<Exit> exits_;
+    std::vector<Literal> literals_;
+
+    // count, jumps and cmp, then a value and a tag for each variable
+    std::vector<std::int64_t> frame_;
+
+    void* code_ {nullptr};
+    std::size_t size_ {0};
+  };
+
+  // entries to a label before the code after it is compiled
+  static constexpr std::size_t threshold {16};
+
+  // program as it runs, one entry for each line, an int overflow
+  // is handed back to the interpreter when checked
+  Jit(Optimizer::Program program, bool const checked);
+
+  // false when the build has no jit for this platform
+  static bool supported();
+
+  // counts an entry to the label on line, compiles once hot,
+  // returns the compiled block or nullptr
+  Block* enter(int const line, std::function<Type(std::string const&)> const& type_of);
+
+  // the block on line could not run with the values it was given,
+  // it is dropped after too many misses and compiled again later
+  void miss(int const line);
+
+private:
+  std::unique_ptr<Block> compile(int const line, std::function<Type(std::string const&)> const& type_of) const;
+
+  Optimizer::Program program_;
+  bool checked_ {false};
+
+  struct Entry
+  {
+    std::size_t count {0};
+    std::size_t misses {0};
+    std::size_t compiles {0};
+    bool failed {false};
+    std::unique_ptr<Block> block;
+  };
+
+  std::map<int, Entry> entries_;
+}; // class Jit
+
+} // namespace OB
+
+#endif // OB_JIT_HH
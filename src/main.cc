@@ -4,10 +4,13 @@ using Parg = OB::Parg;
 #include "pine.hh"
 using Pine = OB::Pine;
 
+#include <cstdint>
 #include <string>
+#include <fstream>
 #include <iostream>
 
 int program_options(Parg& pg);
+void print_stats(std::ostream& os, Pine::Stats const& stats);
 
 int program_options(Parg& pg)
 {
@@ -22,6 +25,21 @@ int program_options(Parg& pg)
   pg.set("help,h", "print the help output");
   pg.set("version,v", "print the program version");
   pg.set("file,f", "", "file_name", "file to read from");
+  pg.set("no-mmap", "read files with ifl through a stream instead of a memory mapping");
+  pg.set("aio", "", "backend", "queue ifl, ofl and afl asynchronously, 'uring' or 'threads'");
+  pg.set("trace", "", "file_name", "write a binary trace of every instruction, read it with pine-trace");
+  pg.set("O0", "run the program as written, the default");
+  pg.set("O1", "propagate and fold constants and remove unreachable code");
+  pg.set("O2", "O1, remove stores that are never read, inline small subroutines and optimize loops");
+  pg.set("dump-ir", "print the program after optimization instead of running it");
+  pg.set("jit", "compile hot loops of int and dbl instructions to native code");
+  pg.set("vm", "run the program on a register vm");
+  pg.set("checked", "stop with an error when an int result overflows instead of wrapping around");
+  pg.set("sample-hz", "0", "int", "sample the call stack this many times per second of cpu time");
+  pg.set("sample-out", "pine.folded", "file_name", "write sampled stacks in folded format for flamegraph.pl");
+  pg.set("limit", "0", "int", "stop with an error after this many instructions, 0 for no limit");
+  pg.set("stats", "print runtime metrics as json to stderr on exit");
+  pg.set("stats-out", "", "file_name", "write the runtime metrics to a file instead of stderr");
   // pg.set("interactive,i", "start in interactive mode");
 
   // pg.set_pos();
@@ -54,6 +72,22 @@ int program_options(Parg& pg)
   return 0;
 }
 
+void print_stats(std::ostream& os, Pine::Stats const& stats)
+{
+  os
+  << "{\n"
+  << "  \"instructions\": " << stats.instructions << ",\n"
+  << "  \"jumps\": " << stats.jumps << ",\n"
+  << "  \"call_stack_max\": " << stats.cst_max << ",\n"
+  << "  \"data_stack_max\": " << stats.stk_max << ",\n"
+  << "  \"variables\": " << stats.variables << ",\n"
+  << "  \"bytes_allocated\": " << stats.bytes_allocated << ",\n"
+  << "  \"allocations\": " << stats.allocations << ",\n"
+  << "  \"io_ns\": " << stats.io_ns << ",\n"
+  << "  \"compute_ns\": " << stats.compute_ns << "\n"
+  << "}\n";
+}
+
 int main(int argc, char *argv[])
 {
   Parg pg {argc, argv};
@@ -75,9 +109,80 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  if (pg.find("aio") && pg.get("aio") != "uring" && pg.get("aio") != "threads")
+  {
+    // error
+    std::cerr << "Error: aio backend must be either 'uring' or 'threads'\n";
+    return 1;
+  }
+
+  if (pg.get<long long>("limit") < 0)
+  {
+    // error
+    std::cerr << "Error: limit must not be negative\n";
+    return 1;
+  }
+
+  if (pg.get<int>("sample-hz") < 0)
+  {
+    // error
+    std::cerr << "Error: sample-hz must not be negative\n";
+    return 1;
+  }
+
   Pine pine;
   pine.set_file(pg.get("file"));
-  pine.run();
+  pine.set_mmap(! pg.get<bool>("no-mmap"));
+  if (pg.find("aio"))
+  {
+    pine.set_aio(pg.get("aio"));
+  }
+  if (pg.find("trace"))
+  {
+    pine.set_trace(pg.get("trace"));
+  }
+  if (pg.get<int>("sample-hz") > 0)
+  {
+    pine.set_sample(pg.get<int>("sample-hz"), pg.get("sample-out"));
+  }
 
-  return 0;
+  if (pg.get<bool>("O2"))
+  {
+    pine.set_opt(2);
+  }
+  else if (pg.get<bool>("O1"))
+  {
+    pine.set_opt(1);
+  }
+  pine.set_dump_ir(pg.get<bool>("dump-ir"));
+  pine.set_jit(pg.get<bool>("jit"));
+  pine.set_vm(pg.get<bool>("vm"));
+  pine.set_checked(pg.get<bool>("checked"));
+  pine.set_limit(static_cast<std::uint64_t>(pg.get<long long>("limit")));
+
+  bool const stats {pg.get<bool>("stats") || pg.find("stats-out")};
+  pine.set_stats(stats);
+
+  int const status {pine.run()};
+
+  if (stats)
+  {
+    if (pg.find("stats-out"))
+    {
+      std::ofstream ofile {pg.get("stats-out")};
+      if (! ofile.is_open())
+      {
+        // error
+        std::cerr << "Error: could not open stats file\n";
+        return 1;
+      }
+      print_stats(ofile, pine.stats());
+    }
+    else
+    {
+      print_stats(std::cerr, pine.stats());
+    }
+  }
+
+  return status;
 }
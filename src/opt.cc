@@ -0,0 +1,1026 @@
+#include "opt.hh"
+#include "cfg.hh"
+#include "conv.hh"
+
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <string>
+
+namespace OB
+{
+  namespace
+  {
+    bool is_arith(std::string const& op)
+    {
+      return op == "add" || op == "sub" || op == "mlt" || op == "div" || op == "mod";
+    }
+
+    bool is_branch(std::string const& op)
+    {
+      return op == "jeq" || op == "jne" || op == "jlt" || op == "jgt" || op == "jge" || op == "jle";
+    }
+
+    // instructions whose operand is a label instead of a variable
+    bool is_control(std::string const& op)
+    {
+      return op == "lbl" || op == "jmp" || op == "run" || op == "ret" || is_branch(op);
+    }
+
+    // instructions that read their operands and change nothing else
+    bool is_reader(std::string const& op)
+    {
+      return op == "prt" || op == "psh" || op == "slp" || op == "ext";
+    }
+
+    // variables an instruction can change
+    std::vector<std::string> writes(Optimizer::Ins const& e)
+    {
+      auto const& op = e.op();
+      if (op == "mov" || is_arith(op))
+      {
+        return {e.args.at(1)};
+      }
+      if (op == "itr")
+      {
+        return {e.args.at(2)};
+      }
+      if (op == "cmp" || is_control(op) || is_reader(op))
+      {
+        return {};
+      }
+      return {e.args.begin() + 1, e.args.end()};
+    }
+
+    // variables an instruction reads, existence checks included
+    std::vector<std::string> reads(Optimizer::Ins const& e)
+    {
+      auto const& op = e.op();
+      if (op == "mov" || is_control(op))
+      {
+        return {};
+      }
+      if (op == "itr")
+      {
+        return {e.args.begin() + 2, e.args.end() - 1};
+      }
+      return {e.args.begin() + 1, e.args.end()};
+    }
+
+    // subroutines of at most this many instructions are inlined
+    constexpr std::size_t inline_max {8};
+
+    bool taken(std::string const& op, int const cmp)
+    {
+      if (op == "jeq") return cmp == 0;
+      if (op == "jne") return cmp != 0;
+      if (op == "jlt") return cmp == -1;
+      if (op == "jgt") return cmp == 1;
+      if (op == "jge") return cmp == 1 || cmp == 0;
+      return cmp == -1 || cmp == 0;
+    }
+  } // namespace
+
+  Optimizer::Optimizer(int const level) :
+    level_ {level}
+  {
+  }
+
+  bool Optimizer::run(Program& program)
+  {
+    folded_ = 0;
+    removed_ = 0;
+    hoisted_ = 0;
+    fused_ = 0;
+    inlined_ = 0;
+
+    if (level_ <= 0)
+    {
+      return false;
+    }
+
+    // state dumps would show the difference
+    for (auto const& e : program)
+    {
+      if (e.is_ins() && e.op() == "dbg")
+      {
+        return false;
+      }
+    }
+
+    if (! resolve_labels(program))
+    {
+      return false;
+    }
+
+    // each pass can expose work for the others, the loop pass
+    // changes one loop at a time
+    for (int i = 0; i < 256; ++i)
+    {
+      bool changed {fold(program)};
+      changed = prune(program) || changed;
+      if (level_ >= 2)
+      {
+        changed = eliminate_stores(program) || changed;
+        changed = inline_calls(program) || changed;
+        resolve_labels(program);
+        changed = optimize_loops(program) || changed;
+      }
+      if (! changed)
+      {
+        break;
+      }
+      resolve_labels(program);
+    }
+
+    compact(program);
+
+    return true;
+  }
+
+  std::size_t Optimizer::folded() const
+  {
+    return folded_;
+  }
+
+  std::size_t Optimizer::removed() const
+  {
+    return removed_;
+  }
+
+  std::size_t Optimizer::hoisted() const
+  {
+    return hoisted_;
+  }
+
+  std::size_t Optimizer::fused() const
+  {
+    return fused_;
+  }
+
+  std::size_t Optimizer::inlined() const
+  {
+    return inlined_;
+  }
+
+  bool Optimizer::resolve_labels(Program const& program)
+  {
+    labels_.clear();
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      auto const& e = program.at(i);
+      if (e.is_ins() && e.op() == "lbl")
+      {
+        // a second declaration is an error at runtime
+        if (! labels_.emplace(e.args.at(1), i).second)
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  std::vector<std::size_t> Optimizer::successors(Program const& program, std::size_t const i) const
+  {
+    return Cfg::successors(program, labels_, i);
+  }
+
+  std::vector<bool> Optimizer::reachable(Program const& program) const
+  {
+    std::vector<bool> seen(program.size(), false);
+    if (program.empty())
+    {
+      return seen;
+    }
+
+    std::deque<std::size_t> work {0};
+    seen.at(0) = true;
+    while (! work.empty())
+    {
+      auto const i = work.front();
+      work.pop_front();
+      for (auto const s : successors(program, i))
+      {
+        if (! seen.at(s))
+        {
+          seen.at(s) = true;
+          work.emplace_back(s);
+        }
+      }
+    }
+
+    return seen;
+  }
+
+  std::vector<Optimizer::Facts> Optimizer::analyze(Program const& program) const
+  {
+    if (program.empty())
+    {
+      return {};
+    }
+
+    // forward dataflow, a variable keeps its constant at a line
+    // only when every path into the line agrees on it
+    std::vector<Facts> in(program.size());
+    in.at(0).reached = true;
+
+    auto const meet = [](Facts& dst, Facts const& src)
+    {
+      if (! dst.reached)
+      {
+        dst = src;
+        dst.reached = true;
+        return true;
+      }
+
+      bool changed {false};
+      for (auto it = dst.vars.begin(); it != dst.vars.end();)
+      {
+        auto const other = src.vars.find(it->first);
+        if (other == src.vars.end() || ! (other->second == it->second))
+        {
+          it = dst.vars.erase(it);
+          changed = true;
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      if (dst.cmp_known && (! src.cmp_known || src.cmp != dst.cmp))
+      {
+        dst.cmp_known = false;
+        changed = true;
+      }
+
+      return changed;
+    };
+
+    auto const known = [](Facts const& f, std::string const& key, Const& val)
+    {
+      auto const it = f.vars.find(key);
+      if (it == f.vars.end())
+      {
+        return false;
+      }
+      val = it->second;
+      return true;
+    };
+
+    std::deque<std::size_t> work {0};
+    while (! work.empty())
+    {
+      auto const i = work.front();
+      work.pop_front();
+
+      auto const& e = program.at(i);
+      Facts out {in.at(i)};
+      bool reset {false};
+
+      if (e.is_ins())
+      {
+        auto const& op = e.op();
+        if (op == "mov")
+        {
+          out.vars[e.args.at(1)] = literal(e.args.at(2));
+        }
+        else if (is_arith(op))
+        {
+          Const lhs;
+          Const rhs;
+          Const res;
+          if (known(out, e.args.at(1), lhs) && known(out, e.args.at(2), rhs) &&
+            compute(op, lhs, rhs, res))
+          {
+            out.vars[e.args.at(1)] = res;
+          }
+          else
+          {
+            out.vars.erase(e.args.at(1));
+          }
+        }
+        else if (op == "cmp")
+        {
+          Const lhs;
+          Const rhs;
+          int cmp {0};
+          out.cmp_known = known(out, e.args.at(1), lhs) && known(out, e.args.at(2), rhs) &&
+            compare(lhs, rhs, cmp);
+          out.cmp = cmp;
+        }
+        else if (op == "itr")
+        {
+          out.vars.erase(e.args.at(2));
+          out.cmp_known = false;
+        }
+        else if (op == "run")
+        {
+          // the subroutine can change anything
+          reset = true;
+        }
+        else if (! is_control(op) && ! is_reader(op))
+        {
+          for (std::size_t j = 1; j < e.args.size(); ++j)
+          {
+            out.vars.erase(e.args.at(j));
+          }
+          out.cmp_known = false;
+        }
+      }
+
+      for (auto const s : successors(program, i))
+      {
+        Facts f;
+        if (! reset)
+        {
+          f = out;
+        }
+        f.reached = true;
+        if (meet(in.at(s), f))
+        {
+          work.emplace_back(s);
+        }
+      }
+    }
+
+    return in;
+  }
+
+  bool Optimizer::fold(Program& program)
+  {
+    auto const in = analyze(program);
+
+    auto const known = [](Facts const& f, std::string const& key, Const& val)
+    {
+      auto const it = f.vars.find(key);
+      if (it == f.vars.end())
+      {
+        return false;
+      }
+      val = it->second;
+      return true;
+    };
+
+    bool changed {false};
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      auto& e = program.at(i);
+      auto const& f = in.at(i);
+      if (! e.is_ins() || ! f.reached)
+      {
+        continue;
+      }
+
+      if (is_arith(e.op()))
+      {
+        Const lhs;
+        Const rhs;
+        Const res;
+        if (known(f, e.args.at(1), lhs) && known(f, e.args.at(2), rhs) &&
+          compute(e.op(), lhs, rhs, res))
+        {
+          assign(e, {"mov", e.args.at(1), encode(res)});
+          ++folded_;
+          changed = true;
+        }
+      }
+      else if (is_branch(e.op()) && f.cmp_known)
+      {
+        if (taken(e.op(), f.cmp))
+        {
+          assign(e, {"jmp", e.args.at(1)});
+          ++folded_;
+        }
+        else
+        {
+          erase(e);
+          ++removed_;
+        }
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+  bool Optimizer::prune(Program& program)
+  {
+    auto const seen = reachable(program);
+
+    bool changed {false};
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      auto& e = program.at(i);
+      if (e.is_ins() && ! seen.at(i))
+      {
+        erase(e);
+        ++removed_;
+        changed = true;
+      }
+    }
+
+    return changed;
+  }
+
+  bool Optimizer::eliminate_stores(Program& program)
+  {
+    // every name used as a variable, live across run and ret
+    std::set<std::string> all;
+    for (auto const& e : program)
+    {
+      if (e.is_ins())
+      {
+        for (auto const& v : reads(e))
+        {
+          all.emplace(v);
+        }
+        for (auto const& v : writes(e))
+        {
+          all.emplace(v);
+        }
+      }
+    }
+
+    std::vector<std::set<std::string>> live_in(program.size());
+    std::vector<std::set<std::string>> live_out(program.size());
+
+    // backward dataflow until nothing changes
+    bool changed {true};
+    while (changed)
+    {
+      changed = false;
+      for (std::size_t n = program.size(); n-- > 0;)
+      {
+        auto const& e = program.at(n);
+
+        std::set<std::string> out;
+        if (e.is_ins() && (e.op() == "run" || e.op() == "ret"))
+        {
+          out = all;
+        }
+        else
+        {
+          for (auto const s : successors(program, n))
+          {
+            out.insert(live_in.at(s).begin(), live_in.at(s).end());
+          }
+        }
+
+        std::set<std::string> in {out};
+        if (e.is_ins())
+        {
+          if (e.op() == "mov")
+          {
+            in.erase(e.args.at(1));
+          }
+          else
+          {
+            // existence checks count as reads
+            for (auto const& v : reads(e))
+            {
+              in.emplace(v);
+            }
+          }
+        }
+
+        if (in != live_in.at(n) || out != live_out.at(n))
+        {
+          live_in.at(n) = std::move(in);
+          live_out.at(n) = std::move(out);
+          changed = true;
+        }
+      }
+    }
+
+    auto const seen = reachable(program);
+
+    bool removed {false};
+    for (std::size_t i = 0; i < program.size(); ++i)
+    {
+      auto& e = program.at(i);
+      if (e.is_ins() && seen.at(i) && e.op() == "mov" &&
+        live_out.at(i).find(e.args.at(1)) == live_out.at(i).end())
+      {
+        erase(e);
+        ++removed_;
+        removed = true;
+      }
+    }
+
+    return removed;
+  }
+
+  bool Optimizer::inline_calls(Program& program)
+  {
+    // a ret drops the variables its run made, so a body can only take
+    // the place of the call when each variable it uses is a global set
+    // before the first label, or is used nowhere else and set by a mov
+    // before the body reads it, either way nothing after the call could
+    // tell the difference
+    std::set<std::string> globals;
+    std::set<std::string> cleared;
+    std::map<std::string, std::set<int>> users;
+    bool prologue {true};
+    for (auto const& e : program)
+    {
+      if (! e.is_ins())
+      {
+        continue;
+      }
+      if (is_control(e.op()) || e.op() == "itr" || e.op() == "ext")
+      {
+        prologue = false;
+      }
+      if (prologue && e.op() == "mov")
+      {
+        globals.emplace(e.args.at(1));
+      }
+      if (e.op() == "clr")
+      {
+        cleared.emplace(e.args.at(1));
+      }
+      for (auto const& v : reads(e))
+      {
+        users[v].emplace(e.line);
+      }
+      for (auto const& v : writes(e))
+      {
+        users[v].emplace(e.line);
+      }
+    }
+
+    // copies keep their source lines, so they count as the body
+    auto const own = [&](std::vector<Ins> const& body)
+    {
+      std::set<int> lines;
+      for (auto const& e : body)
+      {
+        lines.emplace(e.line);
+      }
+
+      std::set<std::string> seen;
+      for (auto const& e : body)
+      {
+        auto names = reads(e);
+        auto const w = writes(e);
+        names.insert(names.end(), w.begin(), w.end());
+        for (auto const& v : names)
+        {
+          if (! seen.emplace(v).second)
+          {
+            continue;
+          }
+          if (globals.find(v) != globals.end() && cleared.find(v) == cleared.end())
+          {
+            continue;
+          }
+          if (e.op() != "mov")
+          {
+            return false;
+          }
+          for (auto const l : users[v])
+          {
+            if (lines.find(l) == lines.end())
+            {
+              return false;
+            }
+          }
+        }
+      }
+
+      return true;
+    };
+
+    // bodies of subroutines that run straight through to a single ret,
+    // a body that calls another subroutine waits until that one is inlined
+    std::map<std::string, std::vector<Ins>> bodies;
+    for (auto const& label : labels_)
+    {
+      std::vector<Ins> body;
+      bool straight {false};
+      for (auto i = label.second + 1; i < program.size(); ++i)
+      {
+        auto const& e = program.at(i);
+        if (! e.is_ins())
+        {
+          continue;
+        }
+        if (e.op() == "ret")
+        {
+          // a ret on the last line never returns
+          straight = i + 1 < program.size();
+          break;
+        }
+        if (is_control(e.op()) || e.op() == "itr" || e.op() == "ext" || body.size() == inline_max)
+        {
+          break;
+        }
+        body.emplace_back(e);
+      }
+      if (straight && own(body))
+      {
+        bodies.emplace(label.first, std::move(body));
+      }
+    }
+
+    // from the end so that the indices still to visit stay put
+    bool changed {false};
+    for (auto i = program.size(); i-- > 0;)
+    {
+      // a call on the last line never happens
+      auto const& site = program.at(i);
+      if (! site.is_ins() || site.op() != "run" || i + 1 == program.size())
+      {
+        continue;
+      }
+
+      auto const body = bodies.find(site.args.at(1));
+      if (body == bodies.end())
+      {
+        continue;
+      }
+
+      // copies keep the source lines of the body for error messages
+      auto const& copy = body->second;
+      program.erase(program.begin() + static_cast<std::ptrdiff_t>(i));
+      program.insert(program.begin() + static_cast<std::ptrdiff_t>(i), copy.begin(), copy.end());
+      ++inlined_;
+      changed = true;
+    }
+
+    return changed;
+  }
+
+  bool Optimizer::optimize_loops(Program& program)
+  {
+    if (program.empty())
+    {
+      return false;
+    }
+
+    Cfg const cfg {program, labels_};
+    auto const& blocks = cfg.blocks();
+    auto const facts = analyze(program);
+
+    auto const uses = [](Ins const& e, std::string const& var)
+    {
+      auto const r = reads(e);
+      return std::find(r.begin(), r.end(), var) != r.end();
+    };
+
+    for (auto const& loop : cfg.loops())
+    {
+      std::vector<std::size_t> lines;
+      for (auto const b : loop.blocks)
+      {
+        for (auto i = blocks.at(b).begin; i < blocks.at(b).end; ++i)
+        {
+          lines.emplace_back(i);
+        }
+      }
+      std::sort(lines.begin(), lines.end());
+      std::set<std::size_t> const in_loop(lines.begin(), lines.end());
+
+      // subroutines can change anything, leave those loops alone
+      bool simple {true};
+      std::map<std::string, std::size_t> defs;
+      for (auto const i : lines)
+      {
+        auto const& e = program.at(i);
+        if (! e.is_ins())
+        {
+          continue;
+        }
+        if (e.op() == "run" || e.op() == "ret")
+        {
+          simple = false;
+          break;
+        }
+        for (auto const& v : writes(e))
+        {
+          ++defs[v];
+        }
+      }
+      if (! simple)
+      {
+        continue;
+      }
+
+      auto const& header = blocks.at(loop.header);
+
+      // blocks that leave the loop or end the program
+      std::vector<std::size_t> exits;
+      for (auto const b : loop.blocks)
+      {
+        auto const& succ = blocks.at(b).succ;
+        if (succ.empty() || std::any_of(succ.begin(), succ.end(),
+          [&](std::size_t const s) { return loop.blocks.count(s) == 0; }))
+        {
+          exits.emplace_back(b);
+        }
+      }
+
+      // hoisted moves go where the loop is entered from a single block
+      std::size_t at {program.size()};
+      std::vector<std::size_t> outside;
+      for (auto const p : header.pred)
+      {
+        if (loop.blocks.count(p) == 0 && cfg.reachable(p))
+        {
+          outside.emplace_back(p);
+        }
+      }
+      if (outside.size() == 1 && blocks.at(outside.front()).succ.size() == 1)
+      {
+        auto const& pre = blocks.at(outside.front());
+        auto const& last = program.at(pre.end - 1);
+        if (last.is_ins() && last.op() == "jmp")
+        {
+          at = pre.end - 1;
+        }
+        else if (pre.end == header.begin)
+        {
+          at = header.begin;
+        }
+      }
+
+      for (auto const i : lines)
+      {
+        auto const& e = program.at(i);
+        if (at == program.size() || ! e.is_ins() || e.op() != "mov" || defs[e.args.at(1)] != 1)
+        {
+          continue;
+        }
+
+        // the move has to run on every way out of the loop
+        auto const b = cfg.block_of(i);
+        if (! std::all_of(exits.begin(), exits.end(),
+          [&](std::size_t const x) { return cfg.dominates(b, x); }))
+        {
+          continue;
+        }
+
+        // and nothing in the loop may read the variable before it
+        auto const& var = e.args.at(1);
+        bool read {false};
+        std::vector<bool> seen(program.size(), false);
+        std::vector<std::size_t> work {header.begin};
+        seen.at(header.begin) = true;
+        while (! work.empty() && ! read)
+        {
+          auto const n = work.back();
+          work.pop_back();
+          if (n == i)
+          {
+            continue;
+          }
+          if (program.at(n).is_ins() && uses(program.at(n), var))
+          {
+            read = true;
+            break;
+          }
+          for (auto const s : successors(program, n))
+          {
+            if (in_loop.count(s) != 0 && ! seen.at(s))
+            {
+              seen.at(s) = true;
+              work.emplace_back(s);
+            }
+          }
+        }
+        if (read)
+        {
+          continue;
+        }
+
+        auto ins = e;
+        program.erase(program.begin() + static_cast<std::ptrdiff_t>(i));
+        auto const pos = at > i ? at - 1 : at;
+        program.insert(program.begin() + static_cast<std::ptrdiff_t>(pos), std::move(ins));
+        ++hoisted_;
+
+        return true;
+      }
+
+      // add, cmp and a branch back to the header make a counted loop
+      for (auto const i : lines)
+      {
+        if (i + 2 >= program.size() || in_loop.count(i + 1) == 0 || in_loop.count(i + 2) == 0)
+        {
+          continue;
+        }
+
+        auto const& add = program.at(i);
+        auto const& cmp = program.at(i + 1);
+        auto const& jmp = program.at(i + 2);
+        if (! add.is_ins() || ! cmp.is_ins() || ! jmp.is_ins() ||
+          add.op() != "add" || cmp.op() != "cmp" || ! is_branch(jmp.op()))
+        {
+          continue;
+        }
+
+        auto const& var = add.args.at(1);
+        auto const& step = add.args.at(2);
+        auto const& limit = cmp.args.at(2);
+        auto const label = labels_.find(jmp.args.at(1));
+        if (cmp.args.at(1) != var || var == step || var == limit ||
+          label == labels_.end() || label->second != header.begin ||
+          defs[var] != 1 || defs[step] != 0 || defs[limit] != 0)
+        {
+          continue;
+        }
+
+        // the induction variable moves by a constant int each time
+        auto const c = facts.at(i).vars.find(step);
+        if (c == facts.at(i).vars.end() || c->second.type != "int")
+        {
+          continue;
+        }
+
+        auto const cond = jmp.op().substr(1);
+        auto const target = jmp.args.at(1);
+        assign(program.at(i), {"itr", cond, var, step, limit, target});
+        program.erase(program.begin() + static_cast<std::ptrdiff_t>(i + 1),
+          program.begin() + static_cast<std::ptrdiff_t>(i + 3));
+        ++fused_;
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Optimizer::compact(Program& program)
+  {
+    program.erase(std::remove_if(program.begin(), program.end(),
+      [](Ins const& e) { return ! e.is_ins(); }), program.end());
+  }
+
+  Optimizer::Const Optimizer::literal(std::string const& val)
+  {
+    // same rules as the mov instruction
+    if (val.at(0) == '\'' && val.at(val.size() - 1) == '\'')
+    {
+      return {"str", val.substr(1, val.size() - 2)};
+    }
+    if (val.at(val.size() - 1) == 'f')
+    {
+      return {"dbl", val.substr(0, val.size() - 1)};
+    }
+    if (val.at(val.size() - 1) == 'n')
+    {
+      return {"big", val.substr(0, val.size() - 1)};
+    }
+    return {"int", val};
+  }
+
+  bool Optimizer::compute(std::string const& op, Const const& lhs, Const const& rhs, Const& res)
+  {
+    // anything that would fail, overflow or trap is left to runtime
+    if (lhs.type == "int" && rhs.type == "int")
+    {
+      std::int64_t a {0};
+      std::int64_t b {0};
+      if (Conv::parse(lhs.value, a) != Conv::Error::none || Conv::parse(rhs.value, b) != Conv::Error::none)
+      {
+        return false;
+      }
+      std::int64_t r {0};
+      bool over {false};
+      if (op == "add") over = __builtin_add_overflow(a, b, &r);
+      else if (op == "sub") over = __builtin_sub_overflow(a, b, &r);
+      else if (op == "mlt") over = __builtin_mul_overflow(a, b, &r);
+      else
+      {
+        if (b == 0 || (a == std::numeric_limits<std::int64_t>::min() && b == -1))
+        {
+          return false;
+        }
+        r = op == "div" ? a / b : a % b;
+      }
+      if (over)
+      {
+        return false;
+      }
+      res.type = "int";
+      Conv::set_int(res.value, r);
+      return true;
+    }
+
+    if (lhs.type == "dbl" && rhs.type == "dbl")
+    {
+      double a {0};
+      double b {0};
+      if (Conv::parse(lhs.value, a) != Conv::Error::none || Conv::parse(rhs.value, b) != Conv::Error::none)
+      {
+        return false;
+      }
+      double r {0};
+      if (op == "add") r = a + b;
+      else if (op == "sub") r = a - b;
+      else if (op == "mlt") r = a * b;
+      else if (op == "div") r = a / b;
+      else r = std::remainder(a, b);
+      res.type = "dbl";
+      Conv::set_dbl(res.value, r);
+      return true;
+    }
+
+    // add on a string keeps the type of the left side
+    if (op == "add" && lhs.type == "str")
+    {
+      if (rhs.type == "dbl")
+      {
+        double b {0};
+        if (Conv::parse(rhs.value, b) != Conv::Error::none)
+        {
+          return false;
+        }
+        char buf[Conv::buffer_size];
+        res = {"str", lhs.value};
+        res.value.append(buf, Conv::write_dbl(buf, b, 1));
+      }
+      else
+      {
+        res = {"str", lhs.value + rhs.value};
+      }
+      return true;
+    }
+
+    return false;
+  }
+
+  bool Optimizer::compare(Const const& lhs, Const const& rhs, int& res)
+  {
+    if (lhs.type == "int" && rhs.type == "int")
+    {
+      std::int64_t a {0};
+      std::int64_t b {0};
+      if (Conv::parse(lhs.value, a) != Conv::Error::none || Conv::parse(rhs.value, b) != Conv::Error::none)
+      {
+        return false;
+      }
+      res = a > b ? 1 : (a < b ? -1 : 0);
+      return true;
+    }
+
+    if (lhs.type == "dbl" && rhs.type == "dbl")
+    {
+      double a {0};
+      double b {0};
+      if (Conv::parse(lhs.value, a) != Conv::Error::none || Conv::parse(rhs.value, b) != Conv::Error::none)
+      {
+        return false;
+      }
+      res = a > b ? 1 : (a < b ? -1 : 0);
+      return true;
+    }
+
+    // a big against an int or a big compares as numbers at runtime
+    if (lhs.type == "big" || rhs.type == "big")
+    {
+      return false;
+    }
+
+    int const c {lhs.value.compare(rhs.value)};
+    res = c > 0 ? 1 : (c < 0 ? -1 : 0);
+    return true;
+  }
+
+  std::string Optimizer::encode(Const const& val)
+  {
+    if (val.type == "str")
+    {
+      return "'" + val.value + "'";
+    }
+    if (val.type == "dbl")
+    {
+      return val.value + "f";
+    }
+    if (val.type == "big")
+    {
+      return val.value + "n";
+    }
+    return val.value;
+  }
+
+  void Optimizer::assign(Ins& ins, std::vector<std::string> args)
+  {
+    ins.args = std::move(args);
+    ins.text = ins.indent;
+    for (std::size_t i = 0; i < ins.args.size(); ++i)
+    {
+      ins.text += (i == 0 ? "" : " ") + ins.args.at(i);
+    }
+  }
+
+  void Optimizer::erase(Ins& ins)
+  {
+    ins.args.clear();
+    ins.text.clear();
+  }
+} // namespace OB
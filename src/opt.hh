@@ -0,0 +1,116 @@
+#ifndef OB_OPT_HH
+#define OB_OPT_HH
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace OB
+{
+class Optimizer
+{
+public:
+  // one decoded source line
+  struct Ins
+  {
+    // line in the source file, kept when the line moves
+    int line {0};
+
+    // leading whitespace and text of the line
+    std::string indent;
+    std::string text;
+
+    // mnemonic followed by the operands, empty for blank and comment lines
+    std::vector<std::string> args;
+
+    bool is_ins() const
+    {
+      return ! args.empty();
+    }
+
+    std::string const& op() const
+    {
+      return args.front();
+    }
+  };
+
+  using Program = std::vector<Ins>;
+
+  // 0 leaves the program as written
+  // 1 propagates and folds constants and removes unreachable code
+  // 2 also removes stores that are never read, inlines small
+  //   subroutines, hoists loop invariant moves and fuses counted loop
+  //   latches into itr
+  explicit Optimizer(int const level);
+
+  // rewrites the program in place, dropping blank and comment lines,
+  // returns false when the program was left as written
+  bool run(Program& program);
+
+  // number of instructions rewritten, removed, hoisted and fused, and
+  // of calls inlined by the last run
+  std::size_t folded() const;
+  std::size_t removed() const;
+  std::size_t hoisted() const;
+  std::size_t fused() const;
+  std::size_t inlined() const;
+
+private:
+  // value of a variable as mov would store it
+  struct Const
+  {
+    std::string type;
+    std::string value;
+
+    bool operator==(Const const& rhs) const
+    {
+      return type == rhs.type && value == rhs.value;
+    }
+  };
+
+  // facts known on entry to an instruction
+  struct Facts
+  {
+    bool reached {false};
+    std::map<std::string, Const> vars;
+    bool cmp_known {false};
+    int cmp {0};
+  };
+
+  bool resolve_labels(Program const& program);
+  std::vector<std::size_t> successors(Program const& program, std::size_t const i) const;
+  std::vector<bool> reachable(Program const& program) const;
+
+  // facts on entry to every line
+  std::vector<Facts> analyze(Program const& program) const;
+
+  bool fold(Program& program);
+  bool prune(Program& program);
+  bool eliminate_stores(Program& program);
+  bool inline_calls(Program& program);
+  bool optimize_loops(Program& program);
+  void compact(Program& program);
+
+  static Const literal(std::string const& val);
+  static bool compute(std::string const& op, Const const& lhs, Const const& rhs, Const& res);
+  static bool compare(Const const& lhs, Const const& rhs, int& res);
+  static std::string encode(Const const& val);
+  static void assign(Ins& ins, std::vector<std::string> args);
+  static void erase(Ins& ins);
+
+  int level_ {0};
+  std::size_t folded_ {0};
+  std::size_t removed_ {0};
+  std::size_t hoisted_ {0};
+  std::size_t fused_ {0};
+  std::size_t inlined_ {0};
+
+  // label name to the index of its line
+  std::map<std::string, std::size_t> labels_;
+}; // class Optimizer
+
+} // namespace OB
+
+#endif // OB_OPT_HH
@@ -331,7 +331,7 @@ private:
   bool is_positional_ {false};
   std::string positional_;
   std::string stdin_;
-  bool is_stdin_;
+  bool is_stdin_ {false};
   int status_ {0};
   std::string error_;
 
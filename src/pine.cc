@@ -1,4 +1,7 @@
 #include "pine.hh"
+#include "alloc.hh"
+#include "conv.hh"
+#include "big.hh"
 
 #define FMT_HEADER_ONLY
 #include "format.h"
@@ -10,6 +13,7 @@
 #include <limits>
 #include <regex>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <memory>
 #include <fstream>
@@ -18,9 +22,119 @@
 #include <vector>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <algorithm>
+#include <type_traits>
+
+#include <unistd.h>
+
+// dbg support, 0 strips the instrumented loop and makes dbg a no-op
+#ifndef PINE_DEBUG
+#define PINE_DEBUG 1
+#endif
 
 namespace OB
 {
+  namespace
+  {
+    // hooks a dispatch loop is compiled with
+    namespace Hook
+    {
+      constexpr unsigned plain {0};
+      constexpr unsigned debug {1 << 0};
+      constexpr unsigned profile {1 << 1};
+      constexpr unsigned trace {1 << 2};
+      constexpr unsigned stats {1 << 3};
+      constexpr unsigned limited {1 << 4};
+      constexpr unsigned jit {1 << 5};
+    } // namespace Hook
+
+    template<unsigned Mask>
+    struct Policy
+    {
+      static constexpr bool debug {(Mask & Hook::debug) != 0};
+      static constexpr bool profile {(Mask & Hook::profile) != 0};
+      static constexpr bool trace {(Mask & Hook::trace) != 0};
+      static constexpr bool stats {(Mask & Hook::stats) != 0};
+      static constexpr bool limited {(Mask & Hook::limited) != 0};
+      static constexpr bool jit {(Mask & Hook::jit) != 0};
+
+      // native code skips the hooks that watch every instruction
+      static constexpr bool valid {! jit || (! debug && ! profile && ! trace && ! limited)};
+    };
+
+    // calls fn with Policy<Mask>, or without the jit when they can't be combined
+    template<unsigned Mask, class Fn, bool = Policy<Mask>::valid>
+    struct Dispatch
+    {
+      static int call(Fn& fn)
+      {
+        return fn(Policy<Mask> {});
+      }
+    };
+
+    template<unsigned Mask, class Fn>
+    struct Dispatch<Mask, Fn, false>
+    {
+      static int call(Fn& fn)
+      {
+        return fn(Policy<Mask & ~Hook::jit> {});
+      }
+    };
+
+    // calls fn with the Policy matching the runtime mask, instantiating
+    // fn once for every valid combination of the hooks in Max, the masks
+    // are its submasks in decreasing order so a hook left out of Max is
+    // never compiled in
+    template<unsigned Mask, class Fn, unsigned Max = Mask>
+    struct Select
+    {
+      static int call(unsigned const mask, Fn& fn)
+      {
+        if (mask == Mask)
+        {
+          return Dispatch<Mask, Fn>::call(fn);
+        }
+        return Select<(Mask - 1) & Max, Fn, Max>::call(mask, fn);
+      }
+    };
+
+    template<class Fn, unsigned Max>
+    struct Select<0, Fn, Max>
+    {
+      static int call(unsigned const, Fn& fn)
+      {
+        return fn(Policy<0> {});
+      }
+    };
+
+    // offset of the first needle in hay at or after pos, npos if there is none,
+    // memchr and memmem scan with the vector units of the cpu
+    std::size_t find_text(char const* hay, std::size_t const size,
+      char const* needle, std::size_t const len, std::size_t const pos)
+    {
+      if (pos > size || len > size - pos)
+      {
+        return std::string::npos;
+      }
+      if (len == 0)
+      {
+        return pos;
+      }
+
+      void const* res {len == 1 ? std::memchr(hay + pos, needle[0], size - pos) :
+        memmem(hay + pos, size - pos, needle, len)};
+      if (res == nullptr)
+      {
+        return std::string::npos;
+      }
+      return static_cast<std::size_t>(static_cast<char const*>(res) - hay);
+    }
+  } // namespace
+
   Pine::Pine()
   {
   }
@@ -29,201 +143,313 @@ namespace OB
   {
   }
 
+  char const* Pine::Instruction::data() const
+  {
+    if (fmap)
+    {
+      return fmap->data() + fmap_off;
+    }
+    return value.data();
+  }
+
+  std::size_t Pine::Instruction::size() const
+  {
+    if (fmap)
+    {
+      return fmap_len;
+    }
+    return value.size();
+  }
+
+  std::string& Pine::Instruction::mut()
+  {
+    if (fmap)
+    {
+      value.assign(data(), size());
+      fmap.reset();
+    }
+    return value;
+  }
+
+  std::string Pine::Instruction::str() const
+  {
+    return std::string(data(), size());
+  }
+
   void Pine::set_file(std::string const _file)
   {
     file_main_ = _file;
   }
 
-  int Pine::run()
+  void Pine::set_mmap(bool const _mmap)
+  {
+    mmap_ = _mmap;
+  }
+
+  void Pine::set_aio(std::string const _backend)
+  {
+    aio_backend_ = _backend;
+  }
+
+  void Pine::set_trace(std::string const _file)
   {
-    // open file
-    std::ifstream ifile {file_main_};
-    if (! ifile.is_open())
+    trace_file_ = _file;
+  }
+
+  void Pine::set_sample(int const _hz, std::string const _file)
+  {
+    sample_hz_ = _hz;
+    sample_file_ = _file;
+  }
+
+  void Pine::set_stats(bool const _stats)
+  {
+    stats_on_ = _stats;
+    if (stats_on_)
     {
-      // error
-      fmt::print("Error: {}\n", "could not open file");
-      return 1;
+      Alloc::enable();
     }
+  }
 
-    auto const print_error = [](int line_num, std::string input, std::string msg)
-    {
-      fmt::print("Error: {}\n  [{}]: {}\n", msg, line_num, input);
-    };
+  void Pine::set_opt(int const _level)
+  {
+    opt_level_ = _level;
+  }
 
-    auto const ins_mov = [&](int line_num, std::string input, std::smatch m)
+  void Pine::set_dump_ir(bool const _dump)
+  {
+    dump_ir_ = _dump;
+  }
+
+  void Pine::set_limit(std::uint64_t const _limit)
+  {
+    limit_ = _limit;
+  }
+
+  void Pine::set_jit(bool const _jit)
+  {
+    jit_on_ = _jit;
+  }
+
+  void Pine::set_vm(bool const _vm)
+  {
+    vm_on_ = _vm;
+  }
+
+  void Pine::set_checked(bool const _checked)
+  {
+    checked_ = _checked;
+  }
+
+  std::uint64_t Pine::instructions() const
+  {
+    return stats_.instructions;
+  }
+
+  Pine::Stats Pine::stats() const
+  {
+    Stats stats {stats_};
+    stats.variables = smap.size();
+    stats.bytes_allocated = Alloc::bytes() - alloc_bytes_;
+    stats.allocations = Alloc::count() - alloc_count_;
+    return stats;
+  }
+
+  int Pine::run()
+  {
+    alloc_bytes_ = Alloc::bytes();
+    alloc_count_ = Alloc::count();
+
+    // read file, the program runs from memory so that it can be optimized
+    std::string source;
     {
-      if (m.size() != 4)
+      std::ifstream file {file_main_};
+      if (! file.is_open())
       {
         // error
-        print_error(line_num, input, "invalid/missing arguments");
+        fmt::print("Error: {}\n", "could not open file");
         return 1;
       }
+      std::ostringstream buf;
+      buf << file.rdbuf();
+      source = buf.str();
+    }
 
-      // impl
-
-      std::string const key {m[2]};
-      std::string const val {m[3]};
-
-      // determine type
-      if (val.at(0) == '\'' && val.at(val.size() - 1) == '\'')
-      {
-        smap[key].value = val.substr(1, val.size() - 2);
-        smap[key].type = "str";
-        smap[key].key = key;
-      }
-      else if (val.at(val.size() - 1) == 'f')
-      {
-        smap[key].value = val.substr(0, val.size() - 1);
-        smap[key].type = "dbl";
-        smap[key].key = key;
-      }
-      else
+    // source line of each line that runs, empty when the program runs as written
+    std::vector<int> line_map;
+    auto const source_line = [&](int const line_num)
+    {
+      if (line_num < 1 || static_cast<std::size_t>(line_num) > line_map.size())
       {
-        smap[key].value = val;
-        smap[key].type = "int";
-        smap[key].key = key;
+        return line_num;
       }
+      return line_map.at(static_cast<std::size_t>(line_num - 1));
+    };
 
-      return 0;
+    auto const print_error = [&](int line_num, std::string input, std::string msg)
+    {
+      fmt::print("Error: {}\n  [{}]: {}\n", msg, source_line(line_num), input);
     };
 
-    auto const ins_add = [&](int line_num, std::string input, std::smatch m)
+    if (! aio_backend_.empty())
     {
-      if (m.size() != 4)
+      aio_ = std::make_unique<Aio>(aio_backend_ == "threads" ?
+        Aio::Backend::threads : Aio::Backend::uring);
+    }
+
+    // completes a pending read into the variable key
+    auto const aio_settle = [&](std::string const& key)
+    {
+      auto const it = aio_reads_.find(key);
+      if (it == aio_reads_.end())
       {
-        // error
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        return 0;
       }
 
-      // impl
+      auto const a = std::move(it->second);
+      aio_reads_.erase(it);
 
-      // check if keys exist
-      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      if (! aio_->wait(*a.op))
       {
-        print_error(line_num, input, "invalid/missing arguments");
+        print_error(a.line, a.input, "could not read file");
         return 1;
       }
 
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
+      smap[key].value = std::move(a.op->data);
 
-      // determine type
-      if (v1.type == "int" && v2.type == "int")
-      {
-        // int
-        v1.value = std::to_string(std::stoi(v1.value) + std::stoi(v2.value));
-      }
-      else if (v1.type == "dbl" && v2.type == "dbl")
+      return 0;
+    };
+
+    // completes pending reads into the variables an instruction names
+    auto const aio_resolve = [&](std::smatch const& m)
+    {
+      if (aio_reads_.empty())
       {
-        // double
-        v1.value = std::to_string(std::stod(v1.value) + std::stod(v2.value));
+        return 0;
       }
-      else
+
+      for (std::size_t i = 2; i < m.size(); ++i)
       {
-        // string
-        if (v1.type == "dbl")
-        {
-          v1.value = fmt::format("{:.1f}", std::stod(v1.value)) + v2.value;
-        }
-        else if (v2.type == "dbl")
-        {
-          v1.value = v1.value + fmt::format("{:.1f}", std::stod(v2.value));
-        }
-        else
+        if (aio_settle(m[i]) != 0)
         {
-          v1.value = v1.value + v2.value;
+          return 1;
         }
       }
 
       return 0;
     };
 
-    auto const ins_sub = [&](int line_num, std::string input, std::smatch m)
+    // completes every pending read and write
+    auto const aio_finish = [&]()
     {
-      if (m.size() != 4)
+      if (! aio_)
       {
-        // error
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        return 0;
       }
 
-      // impl
+      int status {0};
 
-      // check if keys exist
-      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      while (! aio_reads_.empty())
       {
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        auto const key = aio_reads_.begin()->first;
+        auto const a = std::move(aio_reads_.begin()->second);
+        aio_reads_.erase(aio_reads_.begin());
+
+        if (! aio_->wait(*a.op))
+        {
+          print_error(a.line, a.input, "could not read file");
+          status = 1;
+          continue;
+        }
+
+        smap[key].value = std::move(a.op->data);
       }
 
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
+      for (auto const& e : aio_writes_)
+      {
+        if (! aio_->wait(*e.op))
+        {
+          print_error(e.line, e.input, "could not write file");
+          status = 1;
+        }
+      }
+      aio_writes_.clear();
 
-      // determine type
-      if (v1.type == "int" && v2.type == "int")
+      return status;
+    };
+
+    // type of a value read at runtime
+    auto const infer = [](std::string const& val)
+    {
+      // text around a number stays a string
+      if (val.empty() || std::isspace(static_cast<unsigned char>(val.front())) ||
+        std::isspace(static_cast<unsigned char>(val.back())))
       {
-        // int
-        v1.value = std::to_string(std::stoi(v1.value) - std::stoi(v2.value));
+        return "str";
       }
-      else if (v1.type == "dbl" && v2.type == "dbl")
+
+      std::int64_t i {0};
+      if (Conv::parse(val, i) == Conv::Error::none)
       {
-        // double
-        v1.value = std::to_string(std::stod(v1.value) - std::stod(v2.value));
+        return "int";
       }
-      else
+
+      double d {0};
+      if (Conv::parse(val, d) == Conv::Error::none && std::isfinite(d))
       {
-        // error
-        print_error(line_num, input, "can't apply subtraction on strings");
-        return 1;
+        return "dbl";
       }
 
-      return 0;
+      return "str";
     };
 
-    auto const ins_multiply = [&](int line_num, std::string input, std::smatch m)
+    auto const compare = [](Instruction const& lhs, Instruction const& rhs)
     {
-      if (m.size() != 4)
+      std::size_t const n {std::min(lhs.size(), rhs.size())};
+      int const c {n == 0 ? 0 : std::memcmp(lhs.data(), rhs.data(), n)};
+      if (c != 0)
       {
-        // error
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        return c;
       }
-
-      // impl
-
-      // check if keys exist
-      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      if (lhs.size() < rhs.size())
       {
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        return -1;
       }
+      return lhs.size() > rhs.size() ? 1 : 0;
+    };
 
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
+    // stores the literal val of a mov in v, the type is
+    // told by the quotes or the suffix
+    auto const set_literal = [](Instruction& v, std::string const& key, std::string const& val)
+    {
+      v.fmap.reset();
+      v.obj.reset();
+      v.key = key;
 
       // determine type
-      if (v1.type == "int" && v2.type == "int")
+      if (val.at(0) == '\'' && val.at(val.size() - 1) == '\'')
       {
-        // int
-        v1.value = std::to_string(std::stoi(v1.value) * std::stoi(v2.value));
+        v.value = val.substr(1, val.size() - 2);
+        v.type = "str";
       }
-      else if (v1.type == "dbl" && v2.type == "dbl")
+      else if (val.at(val.size() - 1) == 'f')
       {
-        // double
-        v1.value = std::to_string(std::stod(v1.value) * std::stod(v2.value));
+        v.value = val.substr(0, val.size() - 1);
+        v.type = "dbl";
+      }
+      else if (val.at(val.size() - 1) == 'n')
+      {
+        v.value = val.substr(0, val.size() - 1);
+        v.type = "big";
       }
       else
       {
-        // error
-        print_error(line_num, input, "can't apply multiplication on strings");
-        return 1;
+        v.value = val;
+        v.type = "int";
       }
-
-      return 0;
     };
 
-    auto const ins_divide = [&](int line_num, std::string input, std::smatch m)
+    auto const ins_mov = [&](int line_num, std::string input, std::smatch m)
     {
       if (m.size() != 4)
       {
@@ -234,79 +460,442 @@ namespace OB
 
       // impl
 
-      // check if keys exist
-      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
-      {
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
-      }
+      std::string const key {m[2]};
+      set_literal(smap[key], key, m[3]);
+
+      return 0;
+    };
 
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
+    // number held by an int or dbl value
+    auto const parse = [](Instruction const& v, auto& val)
+    {
+      return Conv::parse(v.data(), v.data() + v.size(), val);
+    };
 
-      // determine type
-      if (v1.type == "int" && v2.type == "int")
+    // an int result that did not fit wraps, unless checked
+    auto const overflow = [&](bool const over) -> char const*
+    {
+      return over && checked_ ? "integer overflow" : nullptr;
+    };
+
+    // stores int_fn or dbl_fn of the numbers of two int or two dbl values
+    // in v1, nullptr or the message of the error, int_fn sets its
+    // result and returns nullptr or the message of its own error
+    auto const arith = [&](Instruction& v1, Instruction const& v2,
+      auto const int_fn, auto const dbl_fn) -> char const*
+    {
+      if (v1.type == "int")
       {
-        // int
-        v1.value = std::to_string(std::stoi(v1.value) / std::stoi(v2.value));
+        std::int64_t a {0};
+        std::int64_t b {0};
+        auto err = parse(v1, a);
+        if (err == Conv::Error::none)
+        {
+          err = parse(v2, b);
+        }
+        if (err != Conv::Error::none)
+        {
+          return Conv::message(err);
+        }
+        std::int64_t r {0};
+        auto const msg = int_fn(a, b, r);
+        if (msg != nullptr)
+        {
+          return msg;
+        }
+        Conv::set_int(v1.value, r);
+        return nullptr;
       }
-      else if (v1.type == "dbl" && v2.type == "dbl")
+
+      double a {0};
+      double b {0};
+      auto err = parse(v1, a);
+      if (err == Conv::Error::none)
       {
-        // double
-        v1.value = std::to_string(std::stod(v1.value) / std::stod(v2.value));
+        err = parse(v2, b);
       }
-      else
+      if (err != Conv::Error::none)
       {
-        // error
-        print_error(line_num, input, "can't apply division on strings");
-        return 1;
+        return Conv::message(err);
       }
+      Conv::set_dbl(v1.value, dbl_fn(a, b));
+      return nullptr;
+    };
 
-      return 0;
+    // true when both values are int or big and at least one is big,
+    // the int is then promoted
+    auto const is_big = [](Instruction const& v1, Instruction const& v2)
+    {
+      return (v1.type == "big" || v2.type == "big") &&
+        (v1.type == "int" || v1.type == "big") && (v2.type == "int" || v2.type == "big");
     };
 
-    auto const ins_modulo = [&](int line_num, std::string input, std::smatch m)
+    // number of an int or big value, a big keeps the last result in obj
+    // so a chain of instructions doesn't parse its text again
+    auto const read_big = [](Instruction const& v, Big& val)
     {
-      if (m.size() != 4)
+      if (v.type == "big" && v.obj)
       {
-        // error
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
+        val = *static_cast<Big const*>(v.obj.get());
+        return Conv::Error::none;
       }
+      return Big::parse(v.data(), v.data() + v.size(), val);
+    };
 
-      // impl
+    // stores fn of the numbers of two int or big values in v1 as a big,
+    // fn returns false when it divides by zero,
+    // nullptr or the message of the error
+    auto const big_arith = [&](Instruction& v1, Instruction const& v2, auto const fn) -> char const*
+    {
+      Big b;
+      auto err = read_big(v2, b);
+      if (err != Conv::Error::none)
+      {
+        return Conv::message(err);
+      }
+
+      // the number of v1 is changed in place unless a copy shares it
+      std::shared_ptr<Big> a;
+      if (v1.type == "big" && v1.obj && v1.obj.use_count() == 1)
+      {
+        a = std::static_pointer_cast<Big>(v1.obj);
+      }
+      else
+      {
+        a = std::make_shared<Big>();
+        err = read_big(v1, *a);
+        if (err != Conv::Error::none)
+        {
+          return Conv::message(err);
+        }
+      }
+
+      if (! fn(*a, b))
+      {
+        return "division by zero";
+      }
+      a->write(v1.value);
+      v1.type = "big";
+      v1.obj = std::move(a);
+      return nullptr;
+    };
+
+    // appends a dbl the way add concatenates it to a string or a builder,
+    // without a temporary, nullptr or the message of the error
+    auto const append_dbl = [&](auto& out, Instruction const& v) -> char const*
+    {
+      double val {0};
+      auto const err = parse(v, val);
+      if (err != Conv::Error::none)
+      {
+        return Conv::message(err);
+      }
+
+      char buf[Conv::buffer_size];
+      out.append(buf, Conv::write_dbl(buf, val, 1));
+      return nullptr;
+    };
+
+    // adds v2 to v1, which can be the same value,
+    // nullptr or the message of the error
+    auto const add_values = [&](Instruction& v1, Instruction const& v2) -> char const*
+    {
+      // determine type
+      if ((v1.type == "int" && v2.type == "int") || (v1.type == "dbl" && v2.type == "dbl"))
+      {
+        return arith(v1, v2, [&](std::int64_t a, std::int64_t b, std::int64_t& r)
+          { return overflow(__builtin_add_overflow(a, b, &r)); },
+          [](double a, double b) { return a + b; });
+      }
+      if (is_big(v1, v2))
+      {
+        return big_arith(v1, v2, [](Big& a, Big const& b) { a.add(b); return true; });
+      }
+
+      // string, appended in place so the buffer grows geometrically,
+      // the result is a str whatever the type of v1 was
+      if (v1.type == "dbl")
+      {
+        Instruction const val {v1};
+        v1.value.clear();
+        auto const err = append_dbl(v1.value, val);
+        if (err != nullptr)
+        {
+          v1.value = val.value;
+          return err;
+        }
+        v1.value.append(v2.data(), v2.size());
+      }
+      else if (v2.type == "dbl")
+      {
+        auto const err = append_dbl(v1.mut(), v2);
+        if (err != nullptr)
+        {
+          return err;
+        }
+      }
+      else
+      {
+        // mut first, v2 may be v1 and backed by a file mapping
+        auto& val = v1.mut();
+        val.append(v2.data(), v2.size());
+      }
+      v1.type = "str";
 
+      return nullptr;
+    };
+
+    // adds the value of k2 to k1, nullptr or the message of the error
+    auto const add_keys = [&](std::string const& k1, std::string const& k2) -> char const*
+    {
       // check if keys exist
-      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      if (smap.find(k1) == smap.end() || smap.find(k2) == smap.end())
+      {
+        return "invalid/missing arguments";
+      }
+
+      return add_values(smap[k1], smap[k2]);
+    };
+
+    auto const ins_add = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
       {
+        // error
         print_error(line_num, input, "invalid/missing arguments");
         return 1;
       }
 
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
+      // impl
+
+      auto const err = add_keys(m[2], m[3]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      return 0;
+    };
 
+    // subtracts v2 from v1, nullptr or the message of the error
+    auto const sub_values = [&](Instruction& v1, Instruction const& v2) -> char const*
+    {
       // determine type
-      if (v1.type == "int" && v2.type == "int")
+      if ((v1.type == "int" && v2.type == "int") || (v1.type == "dbl" && v2.type == "dbl"))
       {
-        // int
-        v1.value = std::to_string(std::stoi(v1.value) % std::stoi(v2.value));
+        return arith(v1, v2, [&](std::int64_t a, std::int64_t b, std::int64_t& r)
+          { return overflow(__builtin_sub_overflow(a, b, &r)); },
+          [](double a, double b) { return a - b; });
       }
-      else if (v1.type == "dbl" && v2.type == "dbl")
+      if (is_big(v1, v2))
       {
-        // double
-        v1.value = std::to_string(std::remainder(std::stod(v1.value), std::stod(v2.value)));
+        return big_arith(v1, v2, [](Big& a, Big const& b) { a.sub(b); return true; });
       }
-      else
+
+      return "can't apply subtraction on strings";
+    };
+
+    // multiplies v1 by v2, nullptr or the message of the error
+    auto const mlt_values = [&](Instruction& v1, Instruction const& v2) -> char const*
+    {
+      // determine type
+      if ((v1.type == "int" && v2.type == "int") || (v1.type == "dbl" && v2.type == "dbl"))
+      {
+        return arith(v1, v2, [&](std::int64_t a, std::int64_t b, std::int64_t& r)
+          { return overflow(__builtin_mul_overflow(a, b, &r)); },
+          [](double a, double b) { return a * b; });
+      }
+      if (is_big(v1, v2))
+      {
+        return big_arith(v1, v2, [](Big& a, Big const& b) { a.mlt(b); return true; });
+      }
+
+      return "can't apply multiplication on strings";
+    };
+
+    // divides v1 by v2, nullptr or the message of the error
+    auto const div_values = [&](Instruction& v1, Instruction const& v2) -> char const*
+    {
+      // determine type
+      if ((v1.type == "int" && v2.type == "int") || (v1.type == "dbl" && v2.type == "dbl"))
+      {
+        return arith(v1, v2, [&](std::int64_t a, std::int64_t b, std::int64_t& r) -> char const*
+          {
+            if (b == 0)
+            {
+              return "division by zero";
+            }
+            // the most negative value divided by -1 is the one that overflows
+            if (b == -1)
+            {
+              return overflow(__builtin_sub_overflow(std::int64_t {0}, a, &r));
+            }
+            r = a / b;
+            return nullptr;
+          },
+          [](double a, double b) { return a / b; });
+      }
+      if (is_big(v1, v2))
+      {
+        return big_arith(v1, v2, [](Big& a, Big const& b) { return a.div(b); });
+      }
+
+      return "can't apply division on strings";
+    };
+
+    // stores the remainder of v1 divided by v2 in v1,
+    // nullptr or the message of the error
+    auto const mod_values = [&](Instruction& v1, Instruction const& v2) -> char const*
+    {
+      // determine type
+      if ((v1.type == "int" && v2.type == "int") || (v1.type == "dbl" && v2.type == "dbl"))
+      {
+        return arith(v1, v2, [](std::int64_t a, std::int64_t b, std::int64_t& r) -> char const*
+          {
+            if (b == 0)
+            {
+              return "division by zero";
+            }
+            r = b == -1 ? 0 : a % b;
+            return nullptr;
+          },
+          [](double a, double b) { return std::remainder(a, b); });
+      }
+      if (is_big(v1, v2))
+      {
+        return big_arith(v1, v2, [](Big& a, Big const& b) { return a.mod(b); });
+      }
+
+      return "can't apply modulo on strings";
+    };
+
+    auto const ins_sub = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      auto const err = sub_values(smap[m[2]], smap[m[3]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_multiply = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      auto const err = mlt_values(smap[m[2]], smap[m[3]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_divide = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      auto const err = div_values(smap[m[2]], smap[m[3]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_modulo = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
       {
         // error
-        print_error(line_num, input, "can't apply modulo on strings");
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      auto const err = mod_values(smap[m[2]], smap[m[3]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
         return 1;
       }
 
       return 0;
     };
 
+    // records a name made inside a run as its frame's,
+    // unless a frame cleared it from one of its callers
+    auto const frame_made = [&](std::string const& key)
+    {
+      for (auto const& f : frames_)
+      {
+        if (std::find(f.kept.begin(), f.kept.end(), key) != f.kept.end())
+        {
+          return;
+        }
+      }
+      frames_.back().made.emplace_back(key);
+    };
+
     auto const ins_clear = [&](int line_num, std::string input, std::smatch m)
     {
       if (m.size() != 3)
@@ -326,6 +915,15 @@ namespace OB
         return 1;
       }
 
+      // a variable of a caller cleared here stays the caller's when made again
+      if (! frames_.empty())
+      {
+        auto& f = frames_.back();
+        if (std::find(f.made.begin(), f.made.end(), it->first) == f.made.end())
+        {
+          f.kept.emplace_back(it->first);
+        }
+      }
       smap.erase(it);
 
       return 0;
@@ -353,7 +951,7 @@ namespace OB
       if (stk.empty())
       {
         // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "the stack is empty", line_num, input);
+        print_error(line_num, input, "the stack is empty");
         return 1;
       }
 
@@ -388,6 +986,35 @@ namespace OB
       return 0;
     };
 
+    // writes v and a newline to stdout, nullptr or the message of the error
+    auto const print_value = [&](Instruction const& v) -> char const*
+    {
+      if (v.type == "dbl")
+      {
+        double val {0};
+        auto const err = parse(v, val);
+        if (err != Conv::Error::none)
+        {
+          return Conv::message(err);
+        }
+        char buf[Conv::buffer_size];
+        auto const size = Conv::write_dbl(buf, val, 1);
+        buf[size] = '\n';
+        std::fwrite(buf, 1, size + 1, stdout);
+      }
+      else if (v.fmap)
+      {
+        std::fwrite(v.data(), 1, v.size(), stdout);
+        std::fputc('\n', stdout);
+      }
+      else
+      {
+        fmt::print("{}\n", v.value);
+      }
+
+      return nullptr;
+    };
+
     auto const ins_print = [&](int line_num, std::string input, std::smatch m)
     {
       if (m.size() != 3)
@@ -406,19 +1033,53 @@ namespace OB
         return 1;
       }
 
-      auto& v = smap[m[2]];
-
       // stdout
-      if (v.type == "dbl")
+      auto const err = print_value(smap[m[2]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      return 0;
+    };
+
+    // reads a line into v, its type is inferred from the text,
+    // nullptr or the message of the error
+    auto const ask_value = [&](Instruction& v) -> char const*
+    {
+      v.fmap.reset();
+      v.obj.reset();
+
+      // stdin, checked on the first ask so that a program that never
+      // asks doesn't buffer it
+      if (! stdin_ && ! stdin_tty_)
+      {
+        stdin_tty_ = isatty(STDIN_FILENO) == 1;
+        if (! stdin_tty_)
+        {
+          stdin_ = std::make_unique<Reader>(STDIN_FILENO);
+        }
+      }
+
+      if (stdin_)
       {
-        fmt::print("{:.1f}\n", std::stod(v.value));
+        if (! stdin_->getline(v.value) && stdin_->error())
+        {
+          return "could not read stdin";
+        }
       }
       else
       {
-        fmt::print("{}\n", v.value);
+        std::cout << "> " << std::flush;
+        if (! std::getline(std::cin, v.value) && std::cin.bad())
+        {
+          return "could not read stdin";
+        }
       }
 
-      return 0;
+      v.type = infer(v.value);
+      return nullptr;
     };
 
     auto const ins_ask = [&](int line_num, std::string input, std::smatch m)
@@ -439,11 +1100,12 @@ namespace OB
         return 1;
       }
 
-      // stdin
-      std::string v;
-      std::cout << "> " << std::flush;
-      std::getline(std::cin, v);
-      smap[m[2]].value = v;
+      auto const err = ask_value(smap[m[2]]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
 
       return 0;
     };
@@ -464,7 +1126,7 @@ namespace OB
       if (val != "on" && val != "off")
       {
         // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "value must be either 'on' or 'off'", line_num, input);
+        print_error(line_num, input, "value must be either 'on' or 'off'");
         return 1;
       }
       bool v {false};
@@ -514,10 +1176,15 @@ namespace OB
       else
       {
         // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "invalid/missing arguments", line_num, input);
+        print_error(line_num, input, "invalid/missing arguments");
         return 1;
       }
 
+#if PINE_DEBUG
+      // run picks the loop variant again
+      flg.brk = true;
+#endif
+
       return 0;
     };
 
@@ -554,82 +1221,116 @@ namespace OB
       return 0;
     };
 
-    auto const ins_compare = [&](int line_num, std::string input, std::smatch m)
+    // sets the cmp flag from v1 and v2, nullptr or the message of the error
+    auto const cmp_values = [&](Instruction const& v1, Instruction const& v2) -> char const*
     {
-      if (m.size() != 4)
-      {
-        // error
-        print_error(line_num, input, "invalid/missing arguments");
-        return 1;
-      }
-
-      // impl
-
-      auto& v1 = smap[m[2]];
-      auto& v2 = smap[m[3]];
-
-      // compare key values
-      if (v1.type == "int" && v2.type == "int")
+      // compare key values
+      if (v1.type == "int" && v2.type == "int")
       {
         // int
-        if (std::stoi(v1.value) > std::stoi(v2.value))
-        {
-          // greater then
-          flg.cmp = 1;
-        }
-        else if (std::stoi(v1.value) < std::stoi(v2.value))
+        std::int64_t a {0};
+        std::int64_t b {0};
+        auto err = parse(v1, a);
+        if (err == Conv::Error::none)
         {
-          // less then
-          flg.cmp = -1;
+          err = parse(v2, b);
         }
-        else
+        if (err != Conv::Error::none)
         {
-          // equal
-          flg.cmp = 0;
+          return Conv::message(err);
         }
+        flg.cmp = a > b ? 1 : (a < b ? -1 : 0);
       }
       else if (v1.type == "dbl" && v2.type == "dbl")
       {
         // double
-        if (std::stod(v1.value) > std::stod(v2.value))
-        {
-          // greater then
-          flg.cmp = 1;
-        }
-        else if (std::stod(v1.value) < std::stod(v2.value))
+        double a {0};
+        double b {0};
+        auto err = parse(v1, a);
+        if (err == Conv::Error::none)
         {
-          // less then
-          flg.cmp = -1;
+          err = parse(v2, b);
         }
-        else
+        if (err != Conv::Error::none)
         {
-          // equal
-          flg.cmp = 0;
+          return Conv::message(err);
         }
+        flg.cmp = a > b ? 1 : (a < b ? -1 : 0);
       }
-      else
+      else if (is_big(v1, v2))
       {
-        // string
-        if (v1.value > v2.value)
-        {
-          // greater then
-          flg.cmp = 1;
-        }
-        else if (v1.value < v2.value)
+        // big, or a big and an int
+        Big a;
+        Big b;
+        auto err = read_big(v1, a);
+        if (err == Conv::Error::none)
         {
-          // less then
-          flg.cmp = -1;
+          err = read_big(v2, b);
         }
-        else
+        if (err != Conv::Error::none)
         {
-          // equal
-          flg.cmp = 0;
+          return Conv::message(err);
         }
+        flg.cmp = a.compare(b);
+      }
+      else
+      {
+        // string
+        int const c {compare(v1, v2)};
+        flg.cmp = c > 0 ? 1 : (c < 0 ? -1 : 0);
+      }
+
+      return nullptr;
+    };
+
+    // sets the cmp flag from the values of k1 and k2,
+    // nullptr or the message of the error
+    auto const cmp_keys = [&](std::string const& k1, std::string const& k2) -> char const*
+    {
+      auto& v1 = smap[k1];
+      auto& v2 = smap[k2];
+
+      return cmp_values(v1, v2);
+    };
+
+    auto const ins_compare = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      auto const err = cmp_keys(m[2], m[3]);
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
       }
 
       return 0;
     };
 
+    // the status an ext of v exits with, nullptr or the message of the error
+    auto const exit_code = [&](Instruction const& v, int& code) -> char const*
+    {
+      if (v.type != "int")
+      {
+        return "invalid/missing arguments";
+      }
+
+      auto const err = parse(v, code);
+      if (err != Conv::Error::none)
+      {
+        return Conv::message(err);
+      }
+
+      return nullptr;
+    };
+
     auto const ins_exit = [&](int line_num, std::string input, std::smatch m)
     {
       if (m.size() != 3)
@@ -648,18 +1349,18 @@ namespace OB
         return 1;
       }
 
-      auto& v = smap[m[2]];
-
-      if (v.type != "int")
+      int code {0};
+      auto const err = exit_code(smap[m[2]], code);
+      if (err != nullptr)
       {
-        // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "invalid/missing arguments", line_num, input);
+        print_error(line_num, input, err);
         return 1;
       }
 
-      // exit program
-      // TODO return exit code -1 and handle exit after main loop
-      exit(std::stoi(v.value));
+      // exit program after the current instruction
+      flg.ext.code = code;
+      flg.ext.now = true;
+      flg.brk = true;
 
       return 0;
     };
@@ -801,6 +1502,57 @@ namespace OB
       return 0;
     };
 
+    auto const ins_iterate = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 7)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // add the step to the counter, compare it with the limit and
+      // jump on the condition, the same as add, cmp and a jump
+      auto err = add_keys(m[3], m[4]);
+      if (err == nullptr)
+      {
+        err = cmp_keys(m[3], m[5]);
+      }
+      if (err != nullptr)
+      {
+        print_error(line_num, input, err);
+        return 1;
+      }
+
+      std::string const cond {m[2]};
+      if ((cond == "eq" && flg.cmp == 0) || (cond == "ne" && flg.cmp != 0) ||
+        (cond == "lt" && flg.cmp < 0) || (cond == "gt" && flg.cmp > 0) ||
+        (cond == "ge" && flg.cmp >= 0) || (cond == "le" && flg.cmp <= 0))
+      {
+        flg.jmp.lbl = m[6];
+        flg.jmp.now = true;
+      }
+
+      return 0;
+    };
+
+    // detaches the mappings of a file that is about to be truncated,
+    // false if one could not be
+    auto const unmap = [&](std::string const& path)
+    {
+      for (auto const& e : maps_)
+      {
+        auto const fmap = e.lock();
+        if (fmap && fmap->maps(path) && ! fmap->detach())
+        {
+          return false;
+        }
+      }
+      return true;
+    };
+
     auto const ins_ifile = [&](int line_num, std::string input, std::smatch m)
     {
       if (m.size() != 4)
@@ -819,7 +1571,47 @@ namespace OB
         return 1;
       }
 
-      std::ifstream file {smap[m[3]].value};
+      std::string const path {smap[m[3]].str()};
+
+      if (aio_)
+      {
+        // keep reads ordered after queued writes to the same file
+        aio_->wait(path);
+
+        // queue the read, it completes when the variable is next used
+        auto op = aio_->read(path);
+        if (op)
+        {
+          smap[m[2]].type = "str";
+          smap[m[2]].value.clear();
+          smap[m[2]].fmap.reset();
+          smap[m[2]].obj.reset();
+          aio_reads_[m[2]] = Async {std::move(op), line_num, input};
+          return 0;
+        }
+      }
+
+      // map regular files, the bytes are only read when the script touches them
+      if (mmap_)
+      {
+        auto fmap = std::make_shared<Mmap>(path);
+        if (fmap->is_open())
+        {
+          maps_.erase(std::remove_if(maps_.begin(), maps_.end(),
+            [](std::weak_ptr<Mmap> const& e) { return e.expired(); }), maps_.end());
+          maps_.emplace_back(fmap);
+
+          smap[m[2]].type = "str";
+          smap[m[2]].value.clear();
+          smap[m[2]].obj.reset();
+          smap[m[2]].fmap_off = 0;
+          smap[m[2]].fmap_len = fmap->size();
+          smap[m[2]].fmap = std::move(fmap);
+          return 0;
+        }
+      }
+
+      std::ifstream file {path};
       if (! file.is_open())
       {
         // error
@@ -828,6 +1620,8 @@ namespace OB
       }
 
       smap[m[2]].type = "str";
+      smap[m[2]].fmap.reset();
+      smap[m[2]].obj.reset();
       smap[m[2]].value.assign((std::istreambuf_iterator<char>(file)),
         (std::istreambuf_iterator<char>()));
       file.close();
@@ -853,7 +1647,50 @@ namespace OB
         return 1;
       }
 
-      std::ofstream file {smap[m[3]].value};
+      auto const& v = smap[m[2]];
+      auto const& f = smap[m[3]];
+
+      // write through an open output handle
+      if (f.type == "ofh")
+      {
+        if (! f.obj)
+        {
+          print_error(line_num, input, "file handle is closed");
+          return 1;
+        }
+        if (! static_cast<Writer*>(f.obj.get())->write(v.data(), v.size()))
+        {
+          print_error(line_num, input, "could not write file");
+          return 1;
+        }
+        return 0;
+      }
+
+      // the values viewing a mapping of the file keep their bytes
+      if (m[1] == "ofl" && ! unmap(f.str()))
+      {
+        print_error(line_num, input, "could not open file");
+        return 1;
+      }
+
+      if (aio_)
+      {
+        std::string const path {f.str()};
+        aio_->wait(path);
+
+        // queue the write, it completes on wai or at exit
+        auto op = aio_->write(path, v.str(), m[1] == "afl");
+        if (! op)
+        {
+          print_error(line_num, input, "could not open file");
+          return 1;
+        }
+        aio_writes_.emplace_back(Async {std::move(op), line_num, input});
+        return 0;
+      }
+
+      // ofl truncates, afl appends
+      Writer file {f.str(), m[1] == "afl", 0};
       if (! file.is_open())
       {
         // error
@@ -861,15 +1698,18 @@ namespace OB
          return 1;
       }
 
-      file << smap[m[2]].value;
-      file.close();
+      if (! file.write(v.data(), v.size()) || ! file.close())
+      {
+        print_error(line_num, input, "could not write file");
+        return 1;
+      }
 
       return 0;
     };
 
-    auto const ins_sleep = [&](int line_num, std::string input, std::smatch m)
+    auto const ins_open = [&](int line_num, std::string input, std::smatch m)
     {
-      if (m.size() != 3)
+      if (m.size() != 4)
       {
        // error
         print_error(line_num, input, "invalid/missing arguments");
@@ -878,29 +1718,38 @@ namespace OB
 
       // impl
 
-      // check if key exists
-      if (smap.find(m[2]) == smap.end())
+      // check if keys exists
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
       {
         print_error(line_num, input, "key does not exist");
         return 1;
       }
 
-      auto const& v {smap[m[2]]};
-
-      if (v.type != "int")
+      std::string const path {smap[m[3]].str()};
+      if (aio_)
       {
-        print_error(line_num, input, "value must be an integer");
+        aio_->wait(path);
+      }
+      auto file = std::make_shared<Reader>(path);
+      if (! file->is_open())
+      {
+        // error
+        print_error(line_num, input, "could not open file");
         return 1;
       }
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(std::stoi(v.value)));
+      auto& v = smap[m[2]];
+      v.type = "ifh";
+      v.value = path;
+      v.fmap.reset();
+      v.obj = std::move(file);
 
       return 0;
     };
 
-    auto const ins_run = [&](int line_num, std::string input, std::smatch m)
+    auto const ins_open_write = [&](int line_num, std::string input, std::smatch m)
     {
-      if (m.size() != 3)
+      if (m.size() != 4)
       {
        // error
         print_error(line_num, input, "invalid/missing arguments");
@@ -909,17 +1758,48 @@ namespace OB
 
       // impl
 
-      cst.emplace_back(line_num);
+      // check if keys exists
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
 
-      flg.jmp.lbl = m[2];
-      flg.jmp.now = true;
+      // opw truncates, opa appends
+      std::string const path {smap[m[3]].str()};
+      if (aio_)
+      {
+        aio_->wait(path);
+      }
+      if (m[1] == "opw" && ! unmap(path))
+      {
+        print_error(line_num, input, "could not open file");
+        return 1;
+      }
+      auto file = std::make_shared<Writer>(path, m[1] == "opa");
+      if (! file->is_open())
+      {
+        // error
+        print_error(line_num, input, "could not open file");
+        return 1;
+      }
+
+      outputs_.erase(std::remove_if(outputs_.begin(), outputs_.end(),
+        [](Output const& e) { return e.file.expired(); }), outputs_.end());
+      outputs_.emplace_back(Output {file, line_num, input});
+
+      auto& v = smap[m[2]];
+      v.type = "ofh";
+      v.value = path;
+      v.fmap.reset();
+      v.obj = std::move(file);
 
       return 0;
     };
 
-    auto const ins_return = [&](int line_num, std::string input, std::smatch m)
+    auto const ins_write_line = [&](int line_num, std::string input, std::smatch m)
     {
-      if (m.size() != 2)
+      if (m.size() != 4)
       {
        // error
         print_error(line_num, input, "invalid/missing arguments");
@@ -928,293 +1808,2607 @@ namespace OB
 
       // impl
 
-      // check if stack is empty
-      if (cst.empty())
+      // check if keys exists
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
       {
-        // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "the call stack is empty", line_num, input);
+        print_error(line_num, input, "key does not exist");
         return 1;
       }
 
-      flg.ret.lne = cst.back();
-      flg.ret.now = true;
+      auto const& f = smap[m[2]];
+      if (f.type != "ofh")
+      {
+        print_error(line_num, input, "value must be an output file handle");
+        return 1;
+      }
+      if (! f.obj)
+      {
+        print_error(line_num, input, "file handle is closed");
+        return 1;
+      }
 
-      cst.pop_back();
+      auto const& v = smap[m[3]];
+      auto file = static_cast<Writer*>(f.obj.get());
+      if (! file->write(v.data(), v.size()) || ! file->write("\n", 1))
+      {
+        print_error(line_num, input, "could not write file");
+        return 1;
+      }
 
       return 0;
     };
 
-    // TODO add ins name and documentation to each entry
-    // TODO count num times each ins is called
-    std::map<Regex, std::function<int(int, std::string, std::smatch)>> imap {
-      {"^\\s*(mov)\\s+([0-9a-zA-z]+)\\s+(.+)$", ins_mov},
-      {"^\\s*(clr)\\s+([0-9a-zA-z]+)$", ins_clear},
-
-      {"^\\s*(add)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_add},
-      {"^\\s*(sub)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_sub},
-      {"^\\s*(mlt)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_multiply},
-      {"^\\s*(div)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_divide},
-      {"^\\s*(mod)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_modulo},
-
-      {"^\\s*(lbl)\\s+([0-9a-zA-z]+)$", ins_label},
-
-      {"^\\s*(cmp)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_compare},
-
-      {"^\\s*(jmp)\\s+([0-9a-zA-z]+)$", ins_jump},
-      {"^\\s*(jeq)\\s+([0-9a-zA-z]+)$", ins_jump_equal},
-      {"^\\s*(jne)\\s+([0-9a-zA-z]+)$", ins_jump_not_equal},
-      {"^\\s*(jlt)\\s+([0-9a-zA-z]+)$", ins_jump_less_then},
-      {"^\\s*(jgt)\\s+([0-9a-zA-z]+)$", ins_jump_greater_then},
-      {"^\\s*(jge)\\s+([0-9a-zA-z]+)$", ins_jump_greater_equal},
-      {"^\\s*(jle)\\s+([0-9a-zA-z]+)$", ins_jump_less_equal},
-
-      {"^\\s*(pop)\\s+([0-9a-zA-z]+)$", ins_pop},
-      {"^\\s*(psh)\\s+([0-9a-zA-z]+)$", ins_push},
-
-      // TODO add stdout format options
-      {"^\\s*(prt)\\s+([0-9a-zA-z]+)$", ins_print},
-      {"^\\s*(ask)\\s+([0-9a-zA-z]+)$", ins_ask},
-
-      {"^\\s*(ifl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_ifile},
-      {"^\\s*(ofl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_ofile},
-
-      {"^\\s*(run)\\s+([0-9a-zA-z]+)$", ins_run},
-      {"^\\s*(ret)$", ins_return},
-
-      {"^\\s*(dbg)\\s+([a-z]+)\\s+([a-z]+)$", ins_debug},
-      {"^\\s*(slp)\\s+([0-9a-zA-Z]+)$", ins_sleep},
-      {"^\\s*(ext)\\s+([0-9a-zA-Z]+)$", ins_exit},
-
-      // TODO should comments be handled here instead
-      // {"^\\s*(#)(.*)$", ins_comment},
-    };
-
-    int line_num {0};
-    std::map<int, uint32_t> lines;
-    std::string input;
-    while(std::getline(ifile, input))
+    auto const ins_flush = [&](int line_num, std::string input, std::smatch m)
     {
-      // inc line number
-      ++line_num;
+      if (m.size() != 3)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
 
-      // note fstream byte total
-      lines[line_num] = ifile.tellg();
+      // impl
 
-      // debug
-      if ((flg.dbg.all || flg.dbg.lne))
+      // check if key exists
+      if (smap.find(m[2]) == smap.end())
       {
-        fmt::print("{}: {}\n", line_num, input);
+        print_error(line_num, input, "key does not exist");
+        return 1;
       }
 
-      // handle returns
-      if (flg.ret.now)
+      auto const& f = smap[m[2]];
+      if (f.type != "ofh")
       {
-        ifile.seekg(lines[flg.ret.lne]);
-        line_num = flg.ret.lne;
-        flg.ret.now = false;
-        continue;
+        print_error(line_num, input, "value must be an output file handle");
+        return 1;
       }
-
-      // handle jumps
-      if (flg.jmp.now)
+      if (! f.obj)
       {
-        // debug
-        if (flg.dbg.all || flg.dbg.jmp)
-        {
-          fmt::print("jump: {}\n", flg.jmp.lbl);
-        }
+        print_error(line_num, input, "file handle is closed");
+        return 1;
+      }
 
-        // check if label exists
-        if (lbl.find(flg.jmp.lbl) != lbl.end())
-        {
-          // seen label before
-          ifile.seekg(lines[lbl.at(flg.jmp.lbl).line]);
-          line_num = lbl.at(flg.jmp.lbl).line;
-          flg.jmp.now = false;
+      if (! static_cast<Writer*>(f.obj.get())->flush())
+      {
+        print_error(line_num, input, "could not write file");
+        return 1;
+      }
 
+      return 0;
+    };
+
+    auto const ins_readline = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exists
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& f = smap[m[2]];
+      if (f.type != "ifh")
+      {
+        print_error(line_num, input, "value must be an input file handle");
+        return 1;
+      }
+      if (! f.obj)
+      {
+        print_error(line_num, input, "file handle is closed");
+        return 1;
+      }
+
+      // the line may go into the handle itself, which keeps the reader until it returns
+      auto const fh = f.obj;
+
+      auto& v = smap[m[3]];
+      v.type = "str";
+      v.fmap.reset();
+      v.obj.reset();
+
+      // cmp is 0 while lines remain and 1 at the end of the file
+      auto const reader = static_cast<Reader*>(fh.get());
+      if (reader->getline(v.value))
+      {
+        flg.cmp = 0;
+      }
+      else if (reader->error())
+      {
+        print_error(line_num, input, "could not read file");
+        return 1;
+      }
+      else
+      {
+        flg.cmp = 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_close = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 3)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists
+      if (smap.find(m[2]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto& v = smap[m[2]];
+      if (v.type == "ifh")
+      {
+        if (v.obj)
+        {
+          static_cast<Reader*>(v.obj.get())->close();
+        }
+      }
+      else if (v.type == "ofh")
+      {
+        if (v.obj && ! static_cast<Writer*>(v.obj.get())->close())
+        {
+          v.obj.reset();
+          print_error(line_num, input, "could not write file");
+          return 1;
+        }
+      }
+      else
+      {
+        print_error(line_num, input, "value must be a file handle");
+        return 1;
+      }
+
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_wait = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 2 && m.size() != 3)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      if (m.size() == 3)
+      {
+        // pending reads into the key were completed before dispatch
+        if (smap.find(m[2]) == smap.end())
+        {
+          print_error(line_num, input, "key does not exist");
+          return 1;
+        }
+        return 0;
+      }
+
+      return aio_finish();
+    };
+
+    auto const ins_sleep = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 3)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists
+      if (smap.find(m[2]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& v {smap[m[2]]};
+
+      if (v.type != "int")
+      {
+        print_error(line_num, input, "value must be an integer");
+        return 1;
+      }
+
+      int ms {0};
+      auto const err = parse(v, ms);
+      if (err != Conv::Error::none)
+      {
+        print_error(line_num, input, Conv::message(err));
+        return 1;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+
+      return 0;
+    };
+
+    // reads an int value as an index or size, false if it is not one
+    auto const to_index = [&](Instruction const& v, std::size_t& index)
+    {
+      std::int64_t val {0};
+      if (v.type != "int" || parse(v, val) != Conv::Error::none || val < 0)
+      {
+        return false;
+      }
+      index = static_cast<std::size_t>(val);
+
+      return true;
+    };
+
+    auto const ins_array = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists
+      if (smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      std::size_t size {0};
+      if (! to_index(smap[m[4]], size))
+      {
+        print_error(line_num, input, "size must be an int that is not negative");
+        return 1;
+      }
+
+      std::string const type {m[3]};
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "arr";
+      v.value.clear();
+      v.fmap.reset();
+      v.obj = std::make_shared<Array>(type == "int" ? Array::Type::integer :
+        type == "dbl" ? Array::Type::real : Array::Type::string, size);
+
+      return 0;
+    };
+
+    auto const ins_get = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& a = smap[m[3]];
+      if (a.type != "arr" || ! a.obj)
+      {
+        print_error(line_num, input, "value must be an array");
+        return 1;
+      }
+      auto const arr = static_cast<Array const*>(a.obj.get());
+
+      std::size_t index {0};
+      if (! to_index(smap[m[4]], index) || index >= arr->size())
+      {
+        print_error(line_num, input, "index out of range");
+        return 1;
+      }
+
+      // an element viewing a file mapping stays a view
+      std::shared_ptr<Mmap const> fmap;
+      std::size_t off {0};
+      std::size_t len {0};
+      if (arr->view(index, fmap, off, len))
+      {
+        auto& v = smap[m[2]];
+        v.key = m[2];
+        v.type = "str";
+        v.value.clear();
+        v.obj.reset();
+        v.fmap = std::move(fmap);
+        v.fmap_off = off;
+        v.fmap_len = len;
+
+        return 0;
+      }
+
+      // read before the write, the array may be the destination
+      std::string type {arr->value_type()};
+      std::string value {arr->get(index)};
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = std::move(type);
+      v.value = std::move(value);
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_set = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end() ||
+        smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& a = smap[m[2]];
+      if (a.type != "arr" || ! a.obj)
+      {
+        print_error(line_num, input, "value must be an array");
+        return 1;
+      }
+      auto const arr = static_cast<Array*>(a.obj.get());
+
+      std::size_t index {0};
+      if (! to_index(smap[m[3]], index) || index >= arr->size())
+      {
+        print_error(line_num, input, "index out of range");
+        return 1;
+      }
+
+      auto const& v = smap[m[4]];
+      if (v.type != arr->value_type())
+      {
+        print_error(line_num, input, "value type does not match the array");
+        return 1;
+      }
+      if (! arr->set(index, v.str()))
+      {
+        print_error(line_num, input, "value is not a number");
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_length = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists
+      if (smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& a = smap[m[3]];
+      std::size_t size {0};
+      if (a.type == "str")
+      {
+        size = a.size();
+      }
+      else if (a.type == "arr" && a.obj)
+      {
+        size = static_cast<Array const*>(a.obj.get())->size();
+      }
+      else if (a.type == "map" && a.obj)
+      {
+        size = static_cast<Map const*>(a.obj.get())->size();
+      }
+      else if (a.type == "stb" && a.obj)
+      {
+        size = static_cast<Builder const*>(a.obj.get())->size();
+      }
+      else
+      {
+        print_error(line_num, input, "value must be a str, an array, a map or a string builder");
+        return 1;
+      }
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "int";
+      Conv::set_int(v.value, static_cast<std::int64_t>(size));
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_append = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& a = smap[m[2]];
+      if (a.type != "arr" || ! a.obj)
+      {
+        print_error(line_num, input, "value must be an array");
+        return 1;
+      }
+      auto const arr = static_cast<Array*>(a.obj.get());
+
+      auto const& v = smap[m[3]];
+      if (v.type != arr->value_type())
+      {
+        print_error(line_num, input, "value type does not match the array");
+        return 1;
+      }
+      if (! arr->append(v.str()))
+      {
+        print_error(line_num, input, "value is not a number");
+        return 1;
+      }
+
+      return 0;
+    };
+
+    // int or dbl array of a value, nullptr with the error printed
+    auto const to_vector = [&](int line_num, std::string const& input, Instruction const& a) -> Array*
+    {
+      if (a.type != "arr" || ! a.obj)
+      {
+        print_error(line_num, input, "value must be an array");
+        return nullptr;
+      }
+      auto const arr = static_cast<Array*>(a.obj.get());
+      if (arr->type() == Array::Type::string)
+      {
+        print_error(line_num, input, "can't apply vector arithmetic on strings");
+        return nullptr;
+      }
+      return arr;
+    };
+
+    auto const ins_vector = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const lhs = to_vector(line_num, input, smap[m[2]]);
+      if (lhs == nullptr)
+      {
+        return 1;
+      }
+      auto const rhs = to_vector(line_num, input, smap[m[3]]);
+      if (rhs == nullptr)
+      {
+        return 1;
+      }
+
+      if (lhs->type() != rhs->type() || lhs->size() != rhs->size())
+      {
+        print_error(line_num, input, "arrays must have the same type and size");
+        return 1;
+      }
+
+      std::string const op {m[1]};
+      auto const vop = op == "vadd" ? Array::Op::add : op == "vsub" ? Array::Op::sub :
+        op == "vmlt" ? Array::Op::mlt : op == "vdiv" ? Array::Op::div :
+        op == "vmin" ? Array::Op::min : Array::Op::max;
+
+      if (checked_ && lhs->overflows(vop, *rhs))
+      {
+        print_error(line_num, input, "integer overflow");
+        return 1;
+      }
+      if (! lhs->combine(vop, *rhs))
+      {
+        print_error(line_num, input, "division by zero");
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_reduce = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      std::string const op {m[1]};
+      bool const dot {op == "vdot"};
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || (dot && smap.find(m[4]) == smap.end()))
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const lhs = to_vector(line_num, input, smap[m[3]]);
+      if (lhs == nullptr)
+      {
+        return 1;
+      }
+
+      std::string value;
+      if (dot)
+      {
+        auto const rhs = to_vector(line_num, input, smap[m[4]]);
+        if (rhs == nullptr)
+        {
+          return 1;
+        }
+        if (lhs->type() != rhs->type() || lhs->size() != rhs->size())
+        {
+          print_error(line_num, input, "arrays must have the same type and size");
+          return 1;
+        }
+        if (checked_ && lhs->overflows_dot(*rhs))
+        {
+          print_error(line_num, input, "integer overflow");
+          return 1;
+        }
+        value = lhs->dot(*rhs);
+      }
+      else
+      {
+        if (checked_ && lhs->overflows_sum())
+        {
+          print_error(line_num, input, "integer overflow");
+          return 1;
+        }
+        value = lhs->sum();
+      }
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = lhs->value_type();
+      v.value = std::move(value);
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    // map of a value, nullptr with the error printed
+    auto const to_map = [&](int line_num, std::string const& input, Instruction const& a) -> Map*
+    {
+      if (a.type != "map" || ! a.obj)
+      {
+        print_error(line_num, input, "value must be a map");
+        return nullptr;
+      }
+      return static_cast<Map*>(a.obj.get());
+    };
+
+    // key of an int or str value, ints are written the same way
+    // whatever their text, so 7 and 007 find the same entry
+    auto const to_key = [&](Instruction const& v, std::string& key)
+    {
+      if (v.type == "str")
+      {
+        key.assign(1, 's');
+        key.append(v.data(), v.size());
+        return true;
+      }
+
+      std::int64_t val {0};
+      if (v.type != "int" || parse(v, val) != Conv::Error::none)
+      {
+        return false;
+      }
+
+      char buf[Conv::buffer_size];
+      key.assign(1, 'i');
+      key.append(buf, Conv::write_int(buf, val));
+
+      return true;
+    };
+
+    auto const ins_map = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 3)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "map";
+      v.value.clear();
+      v.fmap.reset();
+      v.obj = std::make_shared<Map>();
+
+      return 0;
+    };
+
+    auto const ins_map_set = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end() ||
+        smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const map = to_map(line_num, input, smap[m[2]]);
+      if (map == nullptr)
+      {
+        return 1;
+      }
+
+      std::string key;
+      if (! to_key(smap[m[3]], key))
+      {
+        print_error(line_num, input, "map key must be an int or a str");
+        return 1;
+      }
+
+      auto const& v = smap[m[4]];
+      if (v.type != "int" && v.type != "dbl" && v.type != "str")
+      {
+        print_error(line_num, input, "map value must be an int, a dbl or a str");
+        return 1;
+      }
+      map->insert(key, {v.type, v.value});
+
+      return 0;
+    };
+
+    auto const ins_map_get = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const map = to_map(line_num, input, smap[m[3]]);
+      if (map == nullptr)
+      {
+        return 1;
+      }
+
+      std::string key;
+      if (! to_key(smap[m[4]], key))
+      {
+        print_error(line_num, input, "map key must be an int or a str");
+        return 1;
+      }
+
+      auto const val = map->find(key);
+      if (val == nullptr)
+      {
+        print_error(line_num, input, "map key is not present");
+        return 1;
+      }
+
+      // copy before the write, the map may be the destination
+      Map::Value res {*val};
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = std::move(res.type);
+      v.value = std::move(res.value);
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_map_delete = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[2]) == smap.end() || smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const map = to_map(line_num, input, smap[m[2]]);
+      if (map == nullptr)
+      {
+        return 1;
+      }
+
+      std::string key;
+      if (! to_key(smap[m[3]], key))
+      {
+        print_error(line_num, input, "map key must be an int or a str");
+        return 1;
+      }
+
+      // removing a missing key is not an error
+      map->erase(key);
+
+      return 0;
+    };
+
+    auto const ins_map_has = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || smap.find(m[4]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const map = to_map(line_num, input, smap[m[3]]);
+      if (map == nullptr)
+      {
+        return 1;
+      }
+
+      std::string key;
+      if (! to_key(smap[m[4]], key))
+      {
+        print_error(line_num, input, "map key must be an int or a str");
+        return 1;
+      }
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "int";
+      v.value = map->find(key) == nullptr ? "0" : "1";
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_builder_append = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists, the builder is made on first use
+      if (smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      if (smap.find(m[2]) == smap.end())
+      {
+        auto& b = smap[m[2]];
+        b.key = m[2];
+        b.type = "stb";
+        b.obj = std::make_shared<Builder>();
+      }
+
+      auto const& b = smap[m[2]];
+      if (b.type != "stb" || ! b.obj)
+      {
+        print_error(line_num, input, "value must be a string builder");
+        return 1;
+      }
+      auto const builder = static_cast<Builder*>(b.obj.get());
+
+      auto const& v = smap[m[3]];
+      if (v.type == "dbl")
+      {
+        auto const err = append_dbl(*builder, v);
+        if (err != nullptr)
+        {
+          print_error(line_num, input, err);
+          return 1;
+        }
+      }
+      else if (v.type == "int" || v.type == "str")
+      {
+        builder->append(v.data(), v.size());
+      }
+      else
+      {
+        print_error(line_num, input, "value must be an int, a dbl or a str");
+        return 1;
+      }
+
+      return 0;
+    };
+
+    auto const ins_builder_str = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 4)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if key exists
+      if (smap.find(m[3]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& b = smap[m[3]];
+      if (b.type != "stb" || ! b.obj)
+      {
+        print_error(line_num, input, "value must be a string builder");
+        return 1;
+      }
+      auto value = static_cast<Builder const*>(b.obj.get())->str();
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "str";
+      v.value = std::move(value);
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_substring = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 6)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || smap.find(m[4]) == smap.end() ||
+        smap.find(m[5]) == smap.end())
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& x = smap[m[3]];
+      if (x.type != "str")
+      {
+        print_error(line_num, input, "value must be a str");
+        return 1;
+      }
+
+      std::size_t pos {0};
+      std::size_t len {0};
+      if (! to_index(smap[m[4]], pos) || pos > x.size())
+      {
+        print_error(line_num, input, "index out of range");
+        return 1;
+      }
+      if (! to_index(smap[m[5]], len))
+      {
+        print_error(line_num, input, "length must be an int that is not negative");
+        return 1;
+      }
+      len = std::min(len, x.size() - pos);
+
+      // a file loaded by ifl is not copied, the result views the mapping
+      if (x.fmap)
+      {
+        auto fmap = x.fmap;
+        auto const off = x.fmap_off + pos;
+
+        auto& v = smap[m[2]];
+        v.key = m[2];
+        v.type = "str";
+        v.value.clear();
+        v.obj.reset();
+        v.fmap = std::move(fmap);
+        v.fmap_off = off;
+        v.fmap_len = len;
+
+        return 0;
+      }
+
+      // copy before the write, x may be the destination
+      std::string value {x.data() + pos, len};
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "str";
+      v.value = std::move(value);
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_find = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 6)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || smap.find(m[4]) == smap.end() ||
+        (m[5].matched && smap.find(m[5]) == smap.end()))
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& x = smap[m[3]];
+      auto const& t = smap[m[4]];
+      if (x.type != "str" || t.type != "str")
+      {
+        print_error(line_num, input, "value must be a str");
+        return 1;
+      }
+
+      std::size_t pos {0};
+      if (m[5].matched && (! to_index(smap[m[5]], pos) || pos > x.size()))
+      {
+        print_error(line_num, input, "index out of range");
+        return 1;
+      }
+
+      auto const at = find_text(x.data(), x.size(), t.data(), t.size(), pos);
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "int";
+      Conv::set_int(v.value, at == std::string::npos ? -1 : static_cast<std::int64_t>(at));
+      v.fmap.reset();
+      v.obj.reset();
+
+      return 0;
+    };
+
+    auto const ins_split = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 5)
+      {
+        // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if keys exist
+      if (smap.find(m[3]) == smap.end() || (m[4].matched && smap.find(m[4]) == smap.end()))
+      {
+        print_error(line_num, input, "key does not exist");
+        return 1;
+      }
+
+      auto const& x = smap[m[3]];
+      if (x.type != "str")
+      {
+        print_error(line_num, input, "value must be a str");
+        return 1;
+      }
+
+      // strings can't hold a newline literal, without a separator
+      // the lines are split as rdl reads them
+      std::string sep {"\n"};
+      bool const lines {! m[4].matched};
+      if (! lines)
+      {
+        auto const& t = smap[m[4]];
+        if (t.type != "str")
+        {
+          print_error(line_num, input, "value must be a str");
+          return 1;
+        }
+        if (t.size() == 0)
+        {
+          print_error(line_num, input, "separator must not be empty");
+          return 1;
+        }
+        sep = t.str();
+      }
+
+      // the pieces of a file loaded by ifl view the mapping like slc does
+      auto arr = x.fmap ? std::make_shared<Array>(x.fmap) : std::make_shared<Array>(Array::Type::string, 0);
+      auto const piece = [&](std::size_t const off, std::size_t const len)
+      {
+        if (x.fmap)
+        {
+          arr->append_view(x.fmap_off + off, len);
+        }
+        else
+        {
+          arr->append(std::string(x.data() + off, len));
+        }
+      };
+
+      std::size_t pos {0};
+      while (! lines || pos < x.size())
+      {
+        auto const at = find_text(x.data(), x.size(), sep.data(), sep.size(), pos);
+        if (at == std::string::npos)
+        {
+          piece(pos, x.size() - pos);
+          break;
+        }
+        piece(pos, at - pos);
+        pos = at + sep.size();
+      }
+
+      auto& v = smap[m[2]];
+      v.key = m[2];
+      v.type = "arr";
+      v.value.clear();
+      v.fmap.reset();
+      v.obj = std::move(arr);
+
+      return 0;
+    };
+
+    // a subroutine sees and changes every variable, the ones it makes
+    // are its temporaries and go away when it returns, a pending read
+    // into one completes first
+    auto const frame_leave = [&]()
+    {
+      for (auto const& key : frames_.back().made)
+      {
+        if (! aio_reads_.empty() && aio_settle(key) != 0)
+        {
+          return 1;
+        }
+        smap.erase(key);
+      }
+      frames_.pop_back();
+
+      return 0;
+    };
+
+    auto const ins_run = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 3)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      cst.emplace_back(line_num);
+      frames_.emplace_back();
+      if (prof_)
+      {
+        prof_calls_.emplace_back(m[2]);
+      }
+
+      flg.jmp.lbl = m[2];
+      flg.jmp.now = true;
+
+      return 0;
+    };
+
+    auto const ins_return = [&](int line_num, std::string input, std::smatch m)
+    {
+      if (m.size() != 2)
+      {
+       // error
+        print_error(line_num, input, "invalid/missing arguments");
+        return 1;
+      }
+
+      // impl
+
+      // check if stack is empty
+      if (cst.empty())
+      {
+        // error
+        print_error(line_num, input, "the call stack is empty");
+        return 1;
+      }
+
+      if (frame_leave() != 0)
+      {
+        return 1;
+      }
+
+      flg.ret.lne = cst.back();
+      flg.ret.now = true;
+
+      cst.pop_back();
+      if (! prof_calls_.empty())
+      {
+        prof_calls_.pop_back();
+      }
+
+      return 0;
+    };
+
+    // TODO add ins name and documentation to each entry
+    // TODO count num times each ins is called
+    std::map<Regex, std::function<int(int, std::string, std::smatch)>> imap {
+      {"^\\s*(mov)\\s+([0-9a-zA-z]+)\\s+(.+)$", ins_mov},
+      {"^\\s*(clr)\\s+([0-9a-zA-z]+)$", ins_clear},
+
+      {"^\\s*(add)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_add},
+      {"^\\s*(sub)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_sub},
+      {"^\\s*(mlt)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_multiply},
+      {"^\\s*(div)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_divide},
+      {"^\\s*(mod)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_modulo},
+
+      {"^\\s*(lbl)\\s+([0-9a-zA-z]+)$", ins_label},
+
+      {"^\\s*(cmp)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_compare},
+
+      {"^\\s*(jmp)\\s+([0-9a-zA-z]+)$", ins_jump},
+      {"^\\s*(jeq)\\s+([0-9a-zA-z]+)$", ins_jump_equal},
+      {"^\\s*(jne)\\s+([0-9a-zA-z]+)$", ins_jump_not_equal},
+      {"^\\s*(jlt)\\s+([0-9a-zA-z]+)$", ins_jump_less_then},
+      {"^\\s*(jgt)\\s+([0-9a-zA-z]+)$", ins_jump_greater_then},
+      {"^\\s*(jge)\\s+([0-9a-zA-z]+)$", ins_jump_greater_equal},
+      {"^\\s*(jle)\\s+([0-9a-zA-z]+)$", ins_jump_less_equal},
+
+      {"^\\s*(itr)\\s+(eq|ne|lt|gt|ge|le)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)\\s+([0-9a-zA-Z]+)\\s+([0-9a-zA-z]+)$", ins_iterate},
+
+      {"^\\s*(pop)\\s+([0-9a-zA-z]+)$", ins_pop},
+      {"^\\s*(psh)\\s+([0-9a-zA-z]+)$", ins_push},
+
+      // TODO add stdout format options
+      {"^\\s*(prt)\\s+([0-9a-zA-z]+)$", ins_print},
+      {"^\\s*(ask)\\s+([0-9a-zA-z]+)$", ins_ask},
+
+      {"^\\s*(ifl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_ifile},
+      {"^\\s*(ofl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_ofile},
+      {"^\\s*(afl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_ofile},
+
+      {"^\\s*(opn)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_open},
+      {"^\\s*(rdl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_readline},
+      {"^\\s*(opw)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_open_write},
+      {"^\\s*(opa)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_open_write},
+      {"^\\s*(wrl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_write_line},
+      {"^\\s*(fls)\\s+([0-9a-zA-z]+)$", ins_flush},
+
+      {"^\\s*(wai)$", ins_wait},
+      {"^\\s*(wai)\\s+([0-9a-zA-z]+)$", ins_wait},
+      {"^\\s*(cls)\\s+([0-9a-zA-z]+)$", ins_close},
+
+      {"^\\s*(arr)\\s+([0-9a-zA-z]+)\\s+(int|dbl|str)\\s+([0-9a-zA-Z]+)$", ins_array},
+      {"^\\s*(get)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_get},
+      {"^\\s*(set)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)\\s+([0-9a-zA-Z]+)$", ins_set},
+      {"^\\s*(len)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)$", ins_length},
+      {"^\\s*(app)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_append},
+      {"^\\s*(vadd|vsub|vmlt|vdiv|vmin|vmax)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_vector},
+      {"^\\s*(vsum)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)()$", ins_reduce},
+      {"^\\s*(vdot)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_reduce},
+      {"^\\s*(hmap)\\s+([0-9a-zA-z]+)$", ins_map},
+      {"^\\s*(hset)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)\\s+([0-9a-zA-Z]+)$", ins_map_set},
+      {"^\\s*(hget)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_map_get},
+      {"^\\s*(hdel)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_map_delete},
+      {"^\\s*(hhas)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_map_has},
+      {"^\\s*(sbapp)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_builder_append},
+      {"^\\s*(sbstr)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_builder_str},
+      {"^\\s*(slc)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)$", ins_substring},
+      {"^\\s*(fnd)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)(?:\\s+([0-9a-zA-Z]+))?$", ins_find},
+      {"^\\s*(spl)\\s+([0-9a-zA-z]+)\\s+([0-9a-zA-Z]+)(?:\\s+([0-9a-zA-Z]+))?$", ins_split},
+
+      {"^\\s*(run)\\s+([0-9a-zA-z]+)$", ins_run},
+      {"^\\s*(ret)$", ins_return},
+
+      {"^\\s*(dbg)\\s+([a-z]+)\\s+([a-z]+)$", ins_debug},
+      {"^\\s*(slp)\\s+([0-9a-zA-Z]+)$", ins_sleep},
+      {"^\\s*(ext)\\s+([0-9a-zA-Z]+)$", ins_exit},
+
+      // TODO should comments be handled here instead
+      // {"^\\s*(#)(.*)$", ins_comment},
+    };
+
+    // the patterns of each op in the order of imap, a line is only matched
+    // against the ones its first word names so each op added costs nothing
+    // on the lines of the others
+    std::unordered_map<std::string, std::vector<decltype(imap)::value_type const*>> ops;
+    for (auto const& e : imap)
+    {
+      auto const pattern = e.first.str();
+      auto const begin = pattern.find('(') + 1;
+      std::stringstream names {pattern.substr(begin, pattern.find(')', begin) - begin)};
+      std::string name;
+      while (std::getline(names, name, '|'))
+      {
+        ops[name].emplace_back(&e);
+      }
+    }
+
+    // patterns that can match a line, empty when its first word is no op
+    auto const patterns = [&](std::string const& line) -> std::vector<decltype(imap)::value_type const*> const&
+    {
+      static std::vector<decltype(imap)::value_type const*> const none;
+      auto const space = " \t\n\v\f\r";
+      auto const begin = line.find_first_not_of(space);
+      if (begin == std::string::npos)
+      {
+        return none;
+      }
+      auto const end = line.find_first_of(space, begin);
+      auto const it = ops.find(line.substr(begin, end == std::string::npos ? end : end - begin));
+      return it == ops.end() ? none : it->second;
+    };
+
+    // decodes each line with the same patterns the loop matches,
+    // valid is false when a line is not an instruction, comment or blank
+    auto const decode = [&](std::string const& text, bool& valid)
+    {
+      Optimizer::Program program;
+      valid = true;
+      std::size_t begin {0};
+      while (begin < text.size())
+      {
+        auto end = text.find('\n', begin);
+        if (end == std::string::npos)
+        {
+          end = text.size();
+        }
+
+        Optimizer::Ins ins;
+        ins.line = static_cast<int>(program.size()) + 1;
+        ins.text = text.substr(begin, end - begin);
+        ins.indent = ins.text.substr(0, ins.text.find_first_not_of(" \t"));
+        begin = end + 1;
+
+        auto const s = ins.text.find_first_not_of(" ");
+        if (! ins.text.empty() && ! (s != std::string::npos && ins.text.at(s) == '#'))
+        {
+          std::smatch match;
+          for (auto const p : patterns(ins.text))
+          {
+            auto const& e = *p;
+            if (std::regex_match(ins.text, match, e.first))
+            {
+              for (std::size_t i = 1; i < match.size(); ++i)
+              {
+                ins.args.emplace_back(match[i]);
+              }
+              break;
+            }
+          }
+          if (! ins.is_ins())
+          {
+            valid = false;
+          }
+        }
+
+        program.emplace_back(std::move(ins));
+      }
+
+      return program;
+    };
+
+    if (opt_level_ > 0 || dump_ir_)
+    {
+      // an invalid line is left to the loop to report
+      bool valid {true};
+      auto program = decode(source, valid);
+
+      // a jump on the last line never happens, the loop ends first
+      auto const transfers = [](Optimizer::Ins const& e)
+      {
+        return e.is_ins() && (e.op() == "jmp" || e.op() == "jeq" || e.op() == "jne" ||
+          e.op() == "jlt" || e.op() == "jgt" || e.op() == "jge" || e.op() == "jle" ||
+          e.op() == "itr" || e.op() == "run" || e.op() == "ret");
+      };
+      int const last {program.empty() ? 0 : program.back().line};
+
+      Optimizer opt {valid ? opt_level_ : 0};
+      if (opt.run(program))
+      {
+        std::string text;
+        for (auto const& e : program)
+        {
+          text += e.text;
+          text += '\n';
+          line_map.emplace_back(e.line);
+        }
+
+        // keep a jump that is only last now that the lines after it are gone
+        if (! program.empty() && transfers(program.back()) && program.back().line != last)
+        {
+          text += '\n';
+          line_map.emplace_back(program.back().line);
+        }
+        source = std::move(text);
+      }
+
+      if (dump_ir_)
+      {
+        fmt::print("# O{}, {} folded, {} removed, {} hoisted, {} fused, {} inlined\n", opt_level_,
+          opt.folded(), opt.removed(), opt.hoisted(), opt.fused(), opt.inlined());
+        for (auto const& e : program)
+        {
+          if (e.is_ins())
+          {
+            fmt::print("{:>5}  {}\n", e.line, e.text);
+          }
+        }
+        return 0;
+      }
+    }
+    std::istringstream ifile {source};
+
+    // offset after each line, where the interpreter picks up after native code
+    std::vector<std::streamoff> jit_ends;
+    if (jit_on_)
+    {
+      if (! Jit::supported())
+      {
+        // error
+        fmt::print("Error: {}\n", "the jit is not supported by this build");
+        return 1;
+      }
+
+      bool valid {true};
+      jit_ = std::make_unique<Jit>(decode(source, valid), checked_);
+      jit_ends.emplace_back(0);
+      for (std::size_t i = 0; i < source.size(); ++i)
+      {
+        if (source.at(i) == '\n')
+        {
+          jit_ends.emplace_back(static_cast<std::streamoff>(i + 1));
+        }
+      }
+      if (! source.empty() && source.back() != '\n')
+      {
+        jit_ends.emplace_back(static_cast<std::streamoff>(source.size()));
+      }
+    }
+
+    // opcode ids written to traces
+    std::vector<std::string> const opcodes {
+      "mov", "clr", "add", "sub", "mlt", "div", "mod", "lbl", "cmp",
+      "jmp", "jeq", "jne", "jlt", "jgt", "jge", "jle", "pop", "psh",
+      "prt", "ask", "ifl", "ofl", "afl", "opn", "rdl", "opw", "opa",
+      "wrl", "fls", "cls", "wai", "run", "ret", "dbg", "slp", "ext",
+      "itr", "arr", "get", "set", "len", "app", "vadd", "vsub", "vmlt",
+      "vdiv", "vmin", "vmax", "vsum", "vdot", "hmap", "hset", "hget",
+      "hdel", "hhas", "sbapp", "sbstr", "slc", "fnd", "spl",
+    };
+    std::map<std::string, std::uint16_t> opcode_ids;
+    for (std::size_t i = 0; i < opcodes.size(); ++i)
+    {
+      opcode_ids[opcodes.at(i)] = static_cast<std::uint16_t>(i);
+    }
+
+    // instructions timed as io by the stats, the rest count as compute
+    std::vector<std::string> const io_opcodes {
+      "prt", "ask", "ifl", "ofl", "afl", "opn", "rdl", "opw", "opa",
+      "wrl", "fls", "cls", "wai",
+    };
+    std::vector<bool> io_ops(opcodes.size(), false);
+    for (auto const& e : io_opcodes)
+    {
+      io_ops.at(opcode_ids.at(e)) = true;
+    }
+
+    if (! trace_file_.empty())
+    {
+      trace_ = std::make_unique<Tracer>(trace_file_, opcodes);
+      if (! trace_->is_open())
+      {
+        // error
+        fmt::print("Error: {}\n", "could not open trace file");
+        return 1;
+      }
+    }
+
+    if (sample_hz_ > 0)
+    {
+      prof_ = std::make_unique<Profiler>(sample_file_, sample_hz_);
+      if (! prof_->is_open())
+      {
+        // error
+        fmt::print("Error: {}\n", "could not open sample file");
+        return 1;
+      }
+    }
+
+    // labels by line, rebuilt when a new label is seen
+    std::map<int, std::string> prof_labels;
+    auto const prof_label = [&](int const line) -> std::string
+    {
+      if (prof_labels.size() != lbl.size())
+      {
+        prof_labels.clear();
+        for (auto const& e : lbl)
+        {
+          prof_labels[e.second.line] = e.first;
+        }
+      }
+
+      // the nearest label at or above the line
+      auto it = prof_labels.upper_bound(line);
+      if (it == prof_labels.begin())
+      {
+        return {};
+      }
+      return (--it)->second;
+    };
+
+    // root is the file, then the label the first call came from,
+    // each run target, and the label of the current line
+    auto const prof_sample = [&](int const line)
+    {
+      auto const slash = file_main_.rfind('/');
+      std::string stack {slash == std::string::npos ? file_main_ : file_main_.substr(slash + 1)};
+      std::string last;
+      auto const frame = [&](std::string const& name)
+      {
+        if (! name.empty() && name != last)
+        {
+          stack += ";" + name;
+          last = name;
+        }
+      };
+
+      if (! cst.empty())
+      {
+        frame(prof_label(cst.front()));
+      }
+      for (auto const& e : prof_calls_)
+      {
+        stack += ";" + e;
+        last = e;
+      }
+      frame(prof_label(line));
+
+      prof_->sample(stack);
+    };
+
+    int line_num {0};
+    std::map<int, uint32_t> lines;
+    std::string input;
+    // state dumps turned on by dbg, printed after each instruction
+    auto const dump = [&]()
+    {
+      if (flg.dbg.all || flg.dbg.map)
+      {
+        fmt::print("map:\n");
+        for (auto const& e : smap)
+        {
+          fmt::print("  {}\n", e.first);
+          fmt::print("    key  -> {}\n", e.second.key);
+          fmt::print("    val  -> {}\n", e.second.str());
+          fmt::print("    type -> {}\n", e.second.type);
+        }
+      }
+      if (flg.dbg.all || flg.dbg.lbl)
+      {
+        fmt::print("labels:\n");
+        for (auto const& e : lbl)
+        {
+          fmt::print("  {} -> {}\n", e.first, e.second.line);
+        }
+      }
+      if (flg.dbg.all || flg.dbg.stk)
+      {
+        fmt::print("stack:\n");
+        for (auto const& e : stk)
+        {
+          fmt::print("  {}\n", e.key);
+          fmt::print("    key  -> {}\n", e.key);
+          fmt::print("    val  -> {}\n", e.str());
+          fmt::print("    type -> {}\n", e.type);
+        }
+      }
+      if (flg.dbg.all || flg.dbg.flg)
+      {
+        fmt::print("flags:\n");
+        fmt::print("  cmp -> {}\n", flg.cmp);
+        fmt::print("  dbg:\n");
+        fmt::print("    all -> {}\n", flg.dbg.all);
+        fmt::print("  jmp:\n");
+        fmt::print("    now -> {}\n", flg.jmp.now);
+        fmt::print("    lbl -> {}\n", flg.jmp.lbl);
+      }
+    };
+
+    std::function<Jit::Type(std::string const&)> const jit_type = [&](std::string const& key)
+    {
+      auto const it = smap.find(key);
+      if (it == smap.end())
+      {
+        return Jit::Type::none;
+      }
+      if (it->second.type == "int")
+      {
+        return Jit::Type::integer;
+      }
+      if (it->second.type == "dbl")
+      {
+        return Jit::Type::real;
+      }
+      return Jit::Type::none;
+    };
+
+    // runs the native code after the label on line once it is hot,
+    // then leaves ifile and the flags where the interpreter picks up
+    auto const jit_run = [&](int const line, bool const timed)
+    {
+      // pending reads complete when their variable is next used
+      if (! aio_reads_.empty())
+      {
+        return;
+      }
+
+      auto const block = jit_->enter(line, jit_type);
+      if (! block)
+      {
+        return;
+      }
+
+      // inputs must still have the types the block was compiled for
+      auto const& vars = block->vars();
+      for (std::size_t i = 0; i < vars.size(); ++i)
+      {
+        auto const& var = vars.at(i);
+        if (! var.input)
+        {
+          continue;
+        }
+
+        if (jit_type(var.name) != var.type)
+        {
+          jit_->miss(line);
+          return;
+        }
+
+        // leave an error to the interpreter
+        auto const& v = smap.at(var.name);
+        if (var.type == Jit::Type::integer)
+        {
+          std::int64_t val {0};
+          if (parse(v, val) != Conv::Error::none)
+          {
+            jit_->miss(line);
+            return;
+          }
+          block->set_int(i, val);
+        }
+        else
+        {
+          double val {0};
+          if (parse(v, val) != Conv::Error::none)
+          {
+            jit_->miss(line);
+            return;
+          }
+          block->set_dbl(i, val);
+        }
+      }
+
+      auto const begin = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point {};
+      auto const& exit = block->run(flg.cmp);
+      stats_.instructions += block->count();
+      if (timed)
+      {
+        stats_.compute_ns += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - begin).count());
+        stats_.jumps += block->jumps();
+      }
+
+      // write back what changed the way the instructions would have
+      for (std::size_t i = 0; i < vars.size(); ++i)
+      {
+        auto const tag = block->tag(i);
+        if (tag == Jit::Block::untouched)
+        {
+          continue;
+        }
+
+        if (! frames_.empty() && smap.find(vars.at(i).name) == smap.end())
+        {
+          frame_made(vars.at(i).name);
+        }
+        auto& v = smap[vars.at(i).name];
+        v.key = vars.at(i).name;
+        v.fmap.reset();
+        v.obj.reset();
+        if (tag == Jit::Block::integer)
+        {
+          v.type = "int";
+          Conv::set_int(v.value, block->get_int(i));
+        }
+        else if (tag == Jit::Block::real)
+        {
+          v.type = "dbl";
+          Conv::set_dbl(v.value, block->get_dbl(i));
+        }
+        else
+        {
+          auto const& lit = block->literal(tag);
+          v.type = lit.type == Jit::Type::integer ? "int" : "dbl";
+          v.value = lit.value;
+        }
+      }
+      flg.cmp = block->cmp();
+
+      // resume after the line the block left on, with its jump pending
+      line_num = exit.line;
+      ifile.seekg(jit_ends.at(static_cast<std::size_t>(exit.line)));
+      lines[line_num] = static_cast<uint32_t>(jit_ends.at(static_cast<std::size_t>(exit.line)));
+      if (! exit.jump.empty())
+      {
+        flg.jmp.lbl = exit.jump;
+        flg.jmp.now = true;
+      }
+    };
+
+    // the dispatch loop, compiled once per Policy so that hooks left out
+    // of a policy cost nothing, a dbg instruction leaves the loop so that
+    // run can switch policies, returns 1 on error
+    auto loop = [&](auto const policy) -> int
+    {
+      using P = std::decay_t<decltype(policy)>;
+      while(std::getline(ifile, input))
+      {
+        // inc line number
+        ++line_num;
+
+        // note fstream byte total
+        lines[line_num] = ifile.tellg();
+
+        // debug
+        if (P::debug && (flg.dbg.all || flg.dbg.lne))
+        {
+          fmt::print("{}: {}\n", source_line(line_num), input);
+        }
+
+        // handle returns
+        if (flg.ret.now)
+        {
+          ifile.seekg(lines[flg.ret.lne]);
+          line_num = flg.ret.lne;
+          flg.ret.now = false;
+          continue;
+        }
+
+        // handle jumps
+        if (flg.jmp.now)
+        {
+          // debug
+          if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+          {
+            fmt::print("jump: {}\n", flg.jmp.lbl);
+          }
+
+          // check if label exists
+          if (lbl.find(flg.jmp.lbl) != lbl.end())
+          {
+            // seen label before
+            ifile.seekg(lines[lbl.at(flg.jmp.lbl).line]);
+            line_num = lbl.at(flg.jmp.lbl).line;
+            flg.jmp.now = false;
+
+            // debug
+            if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+            {
+              fmt::print("jump found: {}\n", flg.jmp.lbl);
+            }
+
+            if (P::jit)
+            {
+              jit_run(line_num, P::stats);
+            }
+
+            // continue if found before
+            continue;
+          }
+          else
+          {
+            // label hasn't been seen yet
+            // TODO jump to highet lbl line number seen so far
+            // if current line num < last label, go to label
+            // debug
+            if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+            {
+              fmt::print("finding label: {}\n", flg.jmp.lbl);
+            }
+          }
+        }
+
+        // handle empty line
+        if (input.empty())
+        {
           // debug
-          if (flg.dbg.all || flg.dbg.jmp)
+          if (P::debug && (flg.dbg.all || flg.dbg.rgx))
+          {
+            fmt::print("empty: [{}]: {}\n", line_num, input);
+          }
+
+          continue;
+        }
+
+        // handle comment
+        {
+          auto s = input.find_first_not_of(" ");
+          if (s != std::string::npos)
+          {
+            if (input.at(s) == '#')
+            {
+              if (P::debug && (flg.dbg.all || flg.dbg.cmt))
+              {
+                fmt::print("comment: [{}]: {}\n", line_num, input);
+              }
+              continue;
+            }
+          }
+        }
+
+        // handle instruction
+        bool valid {false};
+        std::smatch match;
+        for (auto const p : patterns(input))
+        {
+          auto const& e = *p;
+          if (std::regex_match(input, match, e.first))
+          {
+            // debug
+            if (P::debug && (flg.dbg.all || flg.dbg.rgx))
+            {
+              fmt::print("regex:\n");
+              for (size_t i = 0; i < match.size(); ++i)
+              {
+                std::string const s {match[i]};
+                fmt::print("  [{}]: {}\n", i, s);
+              }
+              fmt::print("match: [{}]: {}\n", line_num, input);
+              fmt::print("ins: {}\n", std::string(match[1]));
+            }
+
+            // handle jumps
+            if (flg.jmp.now)
+            {
+              // debug
+              if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+              {
+                fmt::print("jump search: {}\n", flg.jmp.lbl);
+              }
+              if ("lbl" == match[1])
+              {
+                // debug
+                if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+                {
+                  fmt::print("jump found label\n");
+                }
+                auto& ifunc = e.second;
+                int status = ifunc(line_num, input, match);
+                if (status == 0)
+                {
+                  valid = true;
+                  if (flg.jmp.lbl == match[2])
+                  {
+                    flg.jmp.now = false;
+
+                    // debug
+                    if (P::debug && (flg.dbg.all || flg.dbg.jmp))
+                    {
+                      fmt::print("jump found: {}\n", flg.jmp.lbl);
+                    }
+                  }
+                }
+                else
+                {
+                  valid = false;
+                }
+                break;
+              }
+              else
+              {
+                valid = true;
+                break;
+              }
+            }
+            else
+            {
+              auto& ifunc = e.second;
+              ++stats_.instructions;
+              if (P::limited && stats_.instructions > limit_)
+              {
+                // error
+                print_error(line_num, input, "instruction limit reached");
+                return 1;
+              }
+              if (P::profile && Profiler::pending())
+              {
+                prof_sample(line_num);
+              }
+              std::uint64_t const ns {P::trace ? trace_->now() : 0};
+              auto const begin = P::stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point {};
+              // names the instruction makes inside a run belong to its frame
+              unsigned absent {0};
+              if (! frames_.empty())
+              {
+                for (std::size_t i = 2; i < match.size(); ++i)
+                {
+                  if (match[i].length() > 0 && smap.find(match[i]) == smap.end())
+                  {
+                    absent |= 1u << i;
+                  }
+                }
+              }
+              int status = aio_resolve(match);
+              if (status == 0)
+              {
+                status = ifunc(line_num, input, match);
+              }
+              if (absent != 0 && ! frames_.empty())
+              {
+                for (std::size_t i = 2; i < match.size(); ++i)
+                {
+                  if ((absent & (1u << i)) != 0 && smap.find(match[i]) != smap.end())
+                  {
+                    frame_made(match[i]);
+                  }
+                }
+              }
+              if (P::stats)
+              {
+                auto const elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - begin).count());
+                if (io_ops.at(opcode_ids.at(match[1])))
+                {
+                  stats_.io_ns += elapsed;
+                }
+                else
+                {
+                  stats_.compute_ns += elapsed;
+                }
+                if (flg.jmp.now)
+                {
+                  ++stats_.jumps;
+                }
+                stats_.cst_max = std::max(stats_.cst_max, cst.size());
+                stats_.stk_max = std::max(stats_.stk_max, stk.size());
+              }
+              if (P::trace)
+              {
+                trace_->record(ns, static_cast<std::uint32_t>(source_line(line_num)), opcode_ids.at(match[1]),
+                  match.size() > 2 ? trace_->symbol(match[2]) : Trace::none,
+                  match.size() > 3 ? trace_->symbol(match[3]) : Trace::none,
+                  flg.cmp);
+              }
+              if (status == 0)
+              {
+                valid = true;
+              }
+              else
+              {
+                valid = false;
+              }
+              break;
+            }
+          }
+        }
+
+        // handle invalid instruction
+        if (! valid)
+        {
+          // TODO should invalid ins break the program
+          // error
+          print_error(line_num, input, "invalid instruction");
+          return 1;
+        }
+
+        // handle exit and changes to the debug flags
+        if (flg.brk)
+        {
+          flg.brk = false;
+          break;
+        }
+
+        // debug
+        if (P::debug)
+        {
+          dump();
+        }
+      }
+
+      return 0;
+    };
+
+    // a run frame on the vm, the registers it made are reset when it
+    // returns, the same as smap with frames_ and frame_leave
+    struct Frame
+    {
+      std::vector<std::uint32_t> made;
+
+      // registers of its callers it cleared
+      std::vector<std::uint32_t> kept;
+
+      // op after the run that made the frame
+      std::size_t ret {0};
+    };
+
+    // the register code of the program, returns 1 on error
+    auto vm_loop = [&](auto const policy) -> int
+    {
+      using P = std::decay_t<decltype(policy)>;
+      auto const& code = vm_->code();
+      auto const& labels = vm_->labels();
+      auto const& names = vm_->names();
+      int const last {vm_->lines()};
+
+      // each mov copies its literal, made once up front
+      std::vector<Instruction> literals(vm_->literals().size());
+      for (auto const& op : code)
+      {
+        if (op.code == Vm::Code::mov)
+        {
+          set_literal(literals.at(op.b), names.at(op.a), vm_->literals().at(op.b));
+        }
+      }
+
+      // one register for each variable name, live while it holds a value
+      std::vector<Instruction> regs(names.size());
+      std::vector<bool> live(names.size(), false);
+
+      // frame 0 is the top level, frames are kept for the next run at their depth
+      std::vector<Frame> frames(1);
+      std::size_t depth {0};
+
+      auto const find = [&](std::uint32_t const r) -> Instruction*
+      {
+        return live[r] ? &regs[r] : nullptr;
+      };
+
+      // the value of register r, made in the current frame if there is none
+      // and no frame cleared it from a caller
+      auto const make = [&](std::uint32_t const r) -> Instruction&
+      {
+        if (! live[r])
+        {
+          if (depth > 0 && std::none_of(frames.begin() + 1, frames.begin() + static_cast<std::ptrdiff_t>(depth) + 1,
+            [r](Frame const& f) { return std::find(f.kept.begin(), f.kept.end(), r) != f.kept.end(); }))
           {
-            fmt::print("jump found: {}\n", flg.jmp.lbl);
+            frames[depth].made.emplace_back(r);
           }
+          live[r] = true;
+        }
+        return regs[r];
+      };
 
-          // continue if found before
+      // leaves the capacity of the text for the next frame
+      auto const reset = [](Instruction& v)
+      {
+        v.key.clear();
+        v.value.clear();
+        v.type.clear();
+        v.fmap.reset();
+        v.fmap_off = 0;
+        v.fmap_len = 0;
+        v.obj.reset();
+      };
+
+      // the other instructions are called as the loop would call them,
+      // matched once against the line that stays in vm_
+      auto const& calls = vm_->calls();
+      std::vector<std::function<int(int, std::string, std::smatch)> const*> funcs(calls.size(), nullptr);
+      std::vector<std::smatch> matches(calls.size());
+      std::vector<bool> io_calls(calls.size(), false);
+      for (auto const& op : code)
+      {
+        if (op.code != Vm::Code::ins)
+        {
           continue;
         }
-        else
+        for (auto const p : patterns(vm_->text(op.line)))
         {
-          // label hasn't been seen yet
-          // TODO jump to highet lbl line number seen so far
-          // if current line num < last label, go to label
-          // debug
-          if (flg.dbg.all || flg.dbg.jmp)
+          auto const& e = *p;
+          if (std::regex_match(vm_->text(op.line), matches.at(op.a), e.first))
           {
-            fmt::print("finding label: {}\n", flg.jmp.lbl);
+            funcs.at(op.a) = &e.second;
+            break;
           }
         }
+        io_calls.at(op.a) = io_ops.at(opcode_ids.at(calls.at(op.a).name));
       }
 
-      // handle empty line
-      if (input.empty())
-      {
-        // debug
-        if (flg.dbg.all || flg.dbg.rgx)
-        {
-          fmt::print("empty: [{}]: {}\n", line_num, input);
-        }
+      // whether each operand of a call held a value
+      std::vector<bool> owners;
 
-        continue;
-      }
+      // labels passed so far, a jump to one not seen yet looks ahead for it
+      std::vector<bool> seen(labels.size(), false);
 
-      // handle comment
+      // sets next to the op after the label a jump at pc goes to,
+      // false when the program ends first
+      auto const jump = [&](std::size_t const pc, std::uint32_t const label, std::size_t& next)
       {
-        auto s = input.find_first_not_of(" ");
-        if (s != std::string::npos)
+        if (seen[label])
+        {
+          next = labels[label].op + 1;
+          return true;
+        }
+        for (auto i = pc + 1; i < code.size(); ++i)
         {
-          if (input.at(s) == '#')
+          if (code[i].code == Vm::Code::lbl)
           {
-            if (flg.dbg.all || flg.dbg.cmt)
+            seen[code[i].label] = true;
+            if (code[i].label == label)
             {
-              fmt::print("comment: [{}]: {}\n", line_num, input);
+              next = i + 1;
+              return true;
             }
-            continue;
           }
         }
-      }
+        return false;
+      };
 
-      // handle instruction
-      bool valid {false};
-      std::smatch match;
-      for (auto& e : imap)
+      // writes what is left back to smap for the stats
+      auto const finish = [&]()
       {
-        if (std::regex_match(input, match, e.first))
+        for (std::size_t r = 0; r < regs.size(); ++r)
         {
-          // debug
-          if (flg.dbg.all || flg.dbg.rgx)
+          if (live[r])
+          {
+            smap[names[r]] = std::move(regs[r]);
+            live[r] = false;
+          }
+        }
+      };
+
+      std::size_t pc {0};
+      while (pc < code.size())
+      {
+        auto const& op = code[pc];
+        std::size_t next {pc + 1};
+        bool jumped {false};
+        char const* err {nullptr};
+        bool failed {false};
+
+        ++stats_.instructions;
+        if (P::limited && stats_.instructions > limit_)
+        {
+          // error
+          print_error(op.line, vm_->text(op.line), "instruction limit reached");
+          finish();
+          return 1;
+        }
+        auto const begin = P::stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point {};
+
+        switch (op.code)
+        {
+          case Vm::Code::mov:
+          {
+            make(op.a) = literals[op.b];
+            break;
+          }
+
+          case Vm::Code::clr:
           {
-            fmt::print("regex:\n");
-            for (size_t i = 0; i < match.size(); ++i)
+            if (! live[op.a])
+            {
+              err = "invalid/missing arguments";
+              break;
+            }
+            if (depth > 0)
             {
-              std::string const s {match[i]};
-              fmt::print("  [{}]: {}\n", i, s);
+              auto& f = frames[depth];
+              if (std::find(f.made.begin(), f.made.end(), op.a) == f.made.end())
+              {
+                f.kept.emplace_back(op.a);
+              }
             }
-            fmt::print("match: [{}]: {}\n", line_num, input);
-            fmt::print("ins: {}\n", std::string(match[1]));
+            reset(regs[op.a]);
+            live[op.a] = false;
+            break;
           }
 
-          // handle jumps
-          if (flg.jmp.now)
+          case Vm::Code::add:
+          case Vm::Code::sub:
+          case Vm::Code::mlt:
+          case Vm::Code::div:
+          case Vm::Code::mod:
           {
-            // debug
-            if (flg.dbg.all || flg.dbg.jmp)
+            auto const v1 = find(op.a);
+            auto const v2 = find(op.b);
+            if (v1 == nullptr || v2 == nullptr)
             {
-              fmt::print("jump search: {}\n", flg.jmp.lbl);
+              err = "invalid/missing arguments";
+              break;
             }
-            if ("lbl" == match[1])
+            switch (op.code)
             {
-              // debug
-              if (flg.dbg.all || flg.dbg.jmp)
+              case Vm::Code::add: err = add_values(*v1, *v2); break;
+              case Vm::Code::sub: err = sub_values(*v1, *v2); break;
+              case Vm::Code::mlt: err = mlt_values(*v1, *v2); break;
+              case Vm::Code::div: err = div_values(*v1, *v2); break;
+              default: err = mod_values(*v1, *v2); break;
+            }
+            break;
+          }
+
+          case Vm::Code::cmp:
+          {
+            auto& v1 = make(op.a);
+            err = cmp_values(v1, make(op.b));
+            break;
+          }
+
+          case Vm::Code::lbl:
+          {
+            seen[op.label] = true;
+            break;
+          }
+
+          case Vm::Code::jmp:
+          case Vm::Code::jeq:
+          case Vm::Code::jne:
+          case Vm::Code::jlt:
+          case Vm::Code::jgt:
+          case Vm::Code::jge:
+          case Vm::Code::jle:
+          case Vm::Code::itr:
+          {
+            auto cond = op.code;
+            if (op.code == Vm::Code::itr)
+            {
+              auto const v1 = find(op.a);
+              auto const v2 = find(op.b);
+              if (v1 == nullptr || v2 == nullptr)
               {
-                fmt::print("jump found label\n");
+                err = "invalid/missing arguments";
+                break;
               }
-              auto& ifunc = e.second;
-              int status = ifunc(line_num, input, match);
-              if (status == 0)
+              err = add_values(*v1, *v2);
+              if (err != nullptr)
               {
-                valid = true;
-                if (flg.jmp.lbl == match[2])
-                {
-                  flg.jmp.now = false;
-
-                  // debug
-                  if (flg.dbg.all || flg.dbg.jmp)
-                  {
-                    fmt::print("jump found: {}\n", flg.jmp.lbl);
-                  }
-                }
+                break;
               }
-              else
+              err = cmp_values(*v1, make(op.c));
+              if (err != nullptr)
               {
-                valid = false;
+                break;
               }
+              cond = op.cond;
+            }
+            switch (cond)
+            {
+              case Vm::Code::jeq: jumped = flg.cmp == 0; break;
+              case Vm::Code::jne: jumped = flg.cmp != 0; break;
+              case Vm::Code::jlt: jumped = flg.cmp < 0; break;
+              case Vm::Code::jgt: jumped = flg.cmp > 0; break;
+              case Vm::Code::jge: jumped = flg.cmp >= 0; break;
+              case Vm::Code::jle: jumped = flg.cmp <= 0; break;
+              default: jumped = true; break;
+            }
+            break;
+          }
+
+          case Vm::Code::psh:
+          {
+            auto const v = find(op.a);
+            if (v == nullptr)
+            {
+              err = "key does not exist";
               break;
             }
-            else
+            stk.emplace_back(*v);
+            break;
+          }
+
+          case Vm::Code::pop:
+          {
+            auto const v = find(op.a);
+            if (v == nullptr)
+            {
+              err = "key does not exist";
+              break;
+            }
+            if (stk.empty())
             {
-              valid = true;
+              err = "the stack is empty";
               break;
             }
+            *v = std::move(stk.back());
+            stk.pop_back();
+            break;
           }
-          else
+
+          case Vm::Code::prt:
+          case Vm::Code::ask:
+          case Vm::Code::ext:
           {
-            auto& ifunc = e.second;
-            int status = ifunc(line_num, input, match);
-            if (status == 0)
+            auto const v = find(op.a);
+            if (v == nullptr)
+            {
+              err = "key does not exist";
+              break;
+            }
+            if (op.code == Vm::Code::prt)
             {
-              valid = true;
+              err = print_value(*v);
+            }
+            else if (op.code == Vm::Code::ask)
+            {
+              err = ask_value(*v);
             }
             else
             {
-              valid = false;
+              int status {0};
+              err = exit_code(*v, status);
+              if (err == nullptr)
+              {
+                flg.ext.code = status;
+                flg.ext.now = true;
+              }
+            }
+            break;
+          }
+
+          case Vm::Code::run:
+          {
+            ++depth;
+            if (depth == frames.size())
+            {
+              frames.emplace_back();
+            }
+            frames[depth].ret = pc + 1;
+            jumped = true;
+            break;
+          }
+
+          case Vm::Code::ret:
+          {
+            if (depth == 0)
+            {
+              err = "the call stack is empty";
+              break;
+            }
+            auto& f = frames[depth];
+            for (auto const r : f.made)
+            {
+              reset(regs[r]);
+              live[r] = false;
+            }
+            f.made.clear();
+            f.kept.clear();
+            next = f.ret;
+            --depth;
+            break;
+          }
+
+          case Vm::Code::ins:
+          {
+            // the operands are in smap for the call and go back after it
+            auto const& call = calls[op.a];
+            owners.clear();
+            for (auto const r : call.regs)
+            {
+              owners.emplace_back(live[r]);
+              if (live[r])
+              {
+                smap[names[r]] = std::move(regs[r]);
+              }
+            }
+            failed = (*funcs[op.a])(op.line, vm_->text(op.line), matches[op.a]) != 0;
+            for (std::size_t i = 0; i < call.regs.size(); ++i)
+            {
+              auto const r = call.regs[i];
+              auto const it = smap.find(names[r]);
+              if (it == smap.end())
+              {
+                if (owners[i])
+                {
+                  reset(regs[r]);
+                  live[r] = false;
+                }
+                continue;
+              }
+              make(r) = std::move(it->second);
+              smap.erase(it);
             }
             break;
           }
+
+          default:
+          {
+            break;
+          }
         }
-      }
 
-      // handle invalid instruction
-      if (! valid)
-      {
-        // TODO should invalid ins break the program
-        // error
-        fmt::print("Error: {}\n  [{}]: {}\n", "invalid instruction", line_num, input);
-        return 1;
-      }
+        if (P::stats)
+        {
+          auto const elapsed = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count());
+          if (op.code == Vm::Code::prt || op.code == Vm::Code::ask ||
+            (op.code == Vm::Code::ins && io_calls[op.a]))
+          {
+            stats_.io_ns += elapsed;
+          }
+          else
+          {
+            stats_.compute_ns += elapsed;
+          }
+          if (jumped)
+          {
+            ++stats_.jumps;
+          }
+          stats_.cst_max = std::max(stats_.cst_max, depth);
+          stats_.stk_max = std::max(stats_.stk_max, stk.size());
+        }
 
-      // debug
-      if (flg.dbg.all || flg.dbg.map)
-      {
-        fmt::print("map:\n");
-        for (auto const& e : smap)
+        if (err != nullptr)
         {
-          fmt::print("  {}\n", e.first);
-          fmt::print("    key  -> {}\n", e.second.key);
-          fmt::print("    val  -> {}\n", e.second.value);
-          fmt::print("    type -> {}\n", e.second.type);
+          // error
+          print_error(op.line, vm_->text(op.line), err);
+          print_error(op.line, vm_->text(op.line), "invalid instruction");
+          finish();
+          return 1;
+        }
+        if (failed)
+        {
+          // error
+          print_error(op.line, vm_->text(op.line), "invalid instruction");
+          finish();
+          return 1;
         }
+        if (flg.ext.now)
+        {
+          break;
+        }
+
+        // a jump or a ret on the last line never happens
+        if ((jumped || op.code == Vm::Code::ret) && op.line == last)
+        {
+          break;
+        }
+        if (jumped && ! jump(pc, op.label, next))
+        {
+          break;
+        }
+        pc = next;
       }
-      if (flg.dbg.all || flg.dbg.lbl)
+
+      finish();
+
+      return 0;
+    };
+
+    // hooks fixed for the whole run
+    unsigned hooks {Hook::plain};
+    if (prof_)
+    {
+      hooks |= Hook::profile;
+    }
+    if (trace_)
+    {
+      hooks |= Hook::trace;
+    }
+    if (stats_on_)
+    {
+      hooks |= Hook::stats;
+    }
+    if (limit_ > 0)
+    {
+      hooks |= Hook::limited;
+    }
+
+#if PINE_JIT
+    if (jit_)
+    {
+      hooks |= Hook::jit;
+    }
+    constexpr unsigned jit_hook {Hook::jit};
+#else
+    constexpr unsigned jit_hook {0};
+#endif
+
+    // the vm leaves the hooks that watch every instruction and the
+    // pending reads that complete as an instruction names them to the interpreter
+    if (vm_on_ && ! prof_ && ! trace_ && ! aio_)
+    {
+      bool valid {true};
+      auto program = decode(source, valid);
+      if (valid)
       {
-        fmt::print("labels:\n");
-        for (auto const& e : lbl)
+        vm_ = std::make_unique<Vm>(std::move(program));
+        if (! vm_->ok())
         {
-          fmt::print("  {} -> {}\n", e.first, e.second.line);
+          vm_.reset();
         }
       }
-      if (flg.dbg.all || flg.dbg.stk)
+    }
+
+    if (vm_)
+    {
+      int status {0};
+      if (stats_on_ && limit_ > 0)
       {
-        fmt::print("stack:\n");
-        for (auto const& e : stk)
+        status = vm_loop(Policy<Hook::stats | Hook::limited> {});
+      }
+      else if (stats_on_)
+      {
+        status = vm_loop(Policy<Hook::stats> {});
+      }
+      else if (limit_ > 0)
+      {
+        status = vm_loop(Policy<Hook::limited> {});
+      }
+      else
+      {
+        status = vm_loop(Policy<Hook::plain> {});
+      }
+      if (status != 0)
+      {
+        return status;
+      }
+    }
+    else
+    {
+      for (;;)
+      {
+        unsigned mask {hooks};
+#if PINE_DEBUG
+        if (flg.dbg.all || flg.dbg.cmt || flg.dbg.map || flg.dbg.stk ||
+          flg.dbg.lbl || flg.dbg.flg || flg.dbg.jmp || flg.dbg.rgx || flg.dbg.lne)
         {
-          fmt::print("  {}\n", e.key);
-          fmt::print("    key  -> {}\n", e.key);
-          fmt::print("    val  -> {}\n", e.value);
-          fmt::print("    type -> {}\n", e.type);
+          mask |= Hook::debug;
+        }
+        int const status {Select<Hook::debug | Hook::profile | Hook::trace | Hook::stats | Hook::limited | jit_hook,
+          decltype(loop)>::call(mask, loop)};
+#else
+        int const status {Select<Hook::profile | Hook::trace | Hook::stats | Hook::limited | jit_hook,
+          decltype(loop)>::call(mask, loop)};
+#endif
+        if (status != 0)
+        {
+          return status;
         }
+
+        // the loop also returns at the end of the file
+        if (flg.ext.now || ! ifile)
+        {
+          break;
+        }
+
+        // finish the dbg instruction the loop stopped at
+        dump();
       }
-      if (flg.dbg.all || flg.dbg.flg)
+    }
+
+    // write out the rest of the trace and the samples
+    trace_.reset();
+    prof_.reset();
+
+    // a handle still open flushes when it is destroyed, where an error
+    // would be lost, so the ones left are flushed here
+    int status {0};
+    for (auto const& e : outputs_)
+    {
+      auto const file = e.file.lock();
+      if (file && file->is_open() && ! file->flush())
       {
-        fmt::print("flags:\n");
-        fmt::print("  cmp -> {}\n", flg.cmp);
-        fmt::print("  dbg:\n");
-        fmt::print("    all -> {}\n", flg.dbg.all);
-        fmt::print("  jmp:\n");
-        fmt::print("    now -> {}\n", flg.jmp.now);
-        fmt::print("    lbl -> {}\n", flg.jmp.lbl);
+        print_error(e.line, e.input, "could not write file");
+        status = 1;
       }
+    }
+    outputs_.clear();
 
+    if (aio_finish() != 0 || status != 0)
+    {
+      return 1;
     }
-    ifile.close();
-    return 0;
+
+    return flg.ext.code;
   }
 } // namespace OB
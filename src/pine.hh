@@ -1,6 +1,17 @@
 #ifndef OB_PINE_HH
 #define OB_PINE_HH
 
+#include "io.hh"
+#include "array.hh"
+#include "hash.hh"
+#include "builder.hh"
+#include "aio.hh"
+#include "trace.hh"
+#include "profile.hh"
+#include "opt.hh"
+#include "jit.hh"
+#include "vm.hh"
+
 #include <cmath>
 #include <chrono>
 #include <thread>
@@ -14,6 +25,7 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdint>
 
 namespace OB
 {
@@ -73,12 +85,22 @@ public:
     std::string lbl;
   };
 
+  struct Exit
+  {
+    bool now {false};
+    int code {0};
+  };
+
   struct Flags
   {
     Return ret;
     Jump jmp;
+    Exit ext;
     Debug dbg;
     int cmp {0};
+
+    // leave the dispatch loop after the current instruction
+    bool brk {false};
   };
 
   struct Label
@@ -91,16 +113,151 @@ public:
     std::string key;
     std::string value;
     std::string type;
+
+    // read-only file mapping backing a 'str' loaded by ifl
+    // shared on copy, copied into value on the first mutation
+    std::shared_ptr<Mmap const> fmap;
+
+    // bytes of the mapping the value holds, the whole file
+    // or a view into it made by slc
+    std::size_t fmap_off {0};
+    std::size_t fmap_len {0};
+
+    // object owned by a handle value, interpreted by type
+    // 'ifh' -> Reader
+    // 'ofh' -> Writer
+    // 'arr' -> Array, shared by every copy of the value
+    // 'map' -> Map, shared the same way
+    // 'stb' -> Builder, shared the same way
+    // 'big' -> Big, the number value holds as text, a cache that is
+    //          changed in place only while no copy shares it
+    std::shared_ptr<void> obj;
+
+    char const* data() const;
+    std::size_t size() const;
+    std::string& mut();
+    std::string str() const;
+  };
+
+  // counters collected by run, everything but instructions
+  // only when enabled by set_stats
+  struct Stats
+  {
+    std::uint64_t instructions {0};
+    std::uint64_t jumps {0};
+    std::size_t cst_max {0};
+    std::size_t stk_max {0};
+    std::size_t variables {0};
+    std::uint64_t bytes_allocated {0};
+    std::uint64_t allocations {0};
+    std::uint64_t io_ns {0};
+    std::uint64_t compute_ns {0};
   };
 
   Pine();
   ~Pine();
 
   void set_file(std::string const _file);
+  void set_mmap(bool const _mmap);
+  void set_aio(std::string const _backend);
+  void set_trace(std::string const _file);
+  void set_sample(int const _hz, std::string const _file);
+  void set_stats(bool const _stats);
+
+  // optimization level, see Optimizer
+  void set_opt(int const _level);
+
+  // print the program after optimization instead of running it
+  void set_dump_ir(bool const _dump);
+
+  // stop with an error after this many instructions, 0 for no limit
+  void set_limit(std::uint64_t const _limit);
+
+  // compile hot loops to native code, see Jit
+  void set_jit(bool const _jit);
+
+  // run programs on register code, see Vm
+  void set_vm(bool const _vm);
+
+  // an int result that does not fit in 64 bits is an error
+  // instead of wrapping around
+  void set_checked(bool const _checked);
   int run();
 
+  // number of instructions executed by run
+  std::uint64_t instructions() const;
+
+  Stats stats() const;
+
 private:
+  struct Async
+  {
+    std::shared_ptr<Aio::Op> op;
+    int line {0};
+    std::string input;
+  };
+
   std::string file_main_;
+  bool mmap_ {true};
+  bool stats_on_ {false};
+  Stats stats_;
+  std::uint64_t limit_ {0};
+
+  int opt_level_ {0};
+  bool dump_ir_ {false};
+
+  // empty when the jit is off
+  bool jit_on_ {false};
+  std::unique_ptr<Jit> jit_;
+
+  // empty when the vm is off or can't run the program
+  bool vm_on_ {false};
+  std::unique_ptr<Vm> vm_;
+
+  bool checked_ {false};
+
+  // allocator totals when run started
+  std::uint64_t alloc_bytes_ {0};
+  std::uint64_t alloc_count_ {0};
+
+  // made by the first ask when stdin is not a terminal,
+  // ask then reads it in bulk without a prompt
+  std::unique_ptr<Reader> stdin_;
+  bool stdin_tty_ {false};
+
+  // output handle with the line that opened it
+  struct Output
+  {
+    std::weak_ptr<Writer> file;
+    int line {0};
+    std::string input;
+  };
+
+  // handles opened by opw and opa, flushed when the program ends
+  std::vector<Output> outputs_;
+
+  // files mapped by ifl, detached before a write truncates one of them
+  std::vector<std::weak_ptr<Mmap>> maps_;
+
+  // empty when file io is synchronous
+  std::string aio_backend_;
+  std::unique_ptr<Aio> aio_;
+
+  // reads are keyed by the variable they complete into
+  std::map<std::string, Async> aio_reads_;
+  std::vector<Async> aio_writes_;
+
+  // empty when tracing is off
+  std::string trace_file_;
+  std::unique_ptr<Tracer> trace_;
+
+  // zero when sampling is off
+  int sample_hz_ {0};
+  std::string sample_file_;
+  std::unique_ptr<Profiler> prof_;
+
+  // run targets, parallel to cst while sampling
+  std::vector<std::string> prof_calls_;
 
   Flags flg;
   std::vector<Instruction> stk;
@@ -108,6 +265,15 @@ private:
   std::map<std::string, Label> lbl;
   std::map<std::string, Instruction> smap;
 
+  // names a run frame on cst made, dropped at its ret, and the
+  // variables of its callers it cleared, which stay theirs when made again
+  struct Scope
+  {
+    std::vector<std::string> made;
+    std::vector<std::string> kept;
+  };
+  std::vector<Scope> frames_;
+
 };
 
 } // namespace OB
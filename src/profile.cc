@@ -0,0 +1,71 @@
+#include "profile.hh"
+
+#include <cstring>
+#include <algorithm>
+#include <string>
+
+#include <sys/time.h>
+
+namespace OB
+{
+  volatile std::sig_atomic_t Profiler::tick_ {0};
+
+  Profiler::Profiler(std::string const& file, int const hz) :
+    file_ {std::fopen(file.c_str(), "w")}
+  {
+    if (file_ == nullptr || hz <= 0)
+    {
+      return;
+    }
+
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &Profiler::handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, &old_);
+
+    long const usec {std::max(1L, 1000000L / hz)};
+    struct itimerval timer;
+    timer.it_interval.tv_sec = usec / 1000000;
+    timer.it_interval.tv_usec = usec % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+  }
+
+  Profiler::~Profiler()
+  {
+    if (file_ == nullptr)
+    {
+      return;
+    }
+
+    struct itimerval timer;
+    std::memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &old_, nullptr);
+    tick_ = 0;
+
+    // folded stacks, one 'frame;frame;frame count' line per stack
+    for (auto const& e : counts_)
+    {
+      std::fprintf(file_, "%s %llu\n", e.first.c_str(), static_cast<unsigned long long>(e.second));
+    }
+    std::fclose(file_);
+  }
+
+  bool Profiler::is_open() const
+  {
+    return file_ != nullptr;
+  }
+
+  void Profiler::sample(std::string const& stack)
+  {
+    ++counts_[stack];
+  }
+
+  void Profiler::handler(int)
+  {
+    tick_ = 1;
+  }
+} // namespace OB
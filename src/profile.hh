@@ -0,0 +1,52 @@
+#ifndef OB_PROFILE_HH
+#define OB_PROFILE_HH
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace OB
+{
+class Profiler
+{
+public:
+  // samples hz times per second of cpu time through SIGPROF
+  Profiler(std::string const& file, int const hz);
+
+  // stops the timer and writes the folded stacks
+  ~Profiler();
+
+  Profiler(Profiler const&) = delete;
+  Profiler& operator=(Profiler const&) = delete;
+
+  bool is_open() const;
+
+  // true once per timer tick, the interpreter takes the sample
+  // at the next instruction boundary
+  static bool pending()
+  {
+    if (tick_ == 0)
+    {
+      return false;
+    }
+    tick_ = 0;
+    return true;
+  }
+
+  // stack is a list of frames separated by ';', root first
+  void sample(std::string const& stack);
+
+private:
+  static void handler(int);
+  static volatile std::sig_atomic_t tick_;
+
+  std::FILE* file_ {nullptr};
+  std::map<std::string, std::uint64_t> counts_;
+  struct sigaction old_;
+}; // class Profiler
+
+} // namespace OB
+
+#endif // OB_PROFILE_HH
@@ -0,0 +1,608 @@
+#include "simd.hh"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OB_SIMD_X86 1
+#include <immintrin.h>
+#define OB_AVX2 __attribute__((target("avx2")))
+#else
+#define OB_SIMD_X86 0
+#endif
+
+namespace OB
+{
+namespace Simd
+{
+  namespace
+  {
+    enum class Level
+    {
+      scalar,
+      sse2,
+      avx2,
+    };
+
+    Level detect()
+    {
+      Level best {Level::scalar};
+#if OB_SIMD_X86
+      // sse2 is part of x86-64
+      __builtin_cpu_init();
+      best = __builtin_cpu_supports("avx2") ? Level::avx2 : Level::sse2;
+#endif
+
+      char const* const env {std::getenv("PINE_SIMD")};
+      if (env != nullptr)
+      {
+        if (std::strcmp(env, "scalar") == 0)
+        {
+          best = Level::scalar;
+        }
+        else if (std::strcmp(env, "sse2") == 0 && best == Level::avx2)
+        {
+          best = Level::sse2;
+        }
+      }
+
+      return best;
+    }
+
+    Level current()
+    {
+      static Level const level {detect()};
+      return level;
+    }
+
+    // ints wrap around instead of overflowing
+    std::int64_t wrap(std::uint64_t const val)
+    {
+      return static_cast<std::int64_t>(val);
+    }
+
+    std::uint64_t bits(std::int64_t const val)
+    {
+      return static_cast<std::uint64_t>(val);
+    }
+
+#if OB_SIMD_X86
+    // low 64 bits of the products, there is no 64 bit multiply before avx512
+    __m128i mullo(__m128i const lhs, __m128i const rhs)
+    {
+      auto const low = _mm_mul_epu32(lhs, rhs);
+      auto const cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(lhs, 32), rhs),
+        _mm_mul_epu32(lhs, _mm_srli_epi64(rhs, 32)));
+      return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+    }
+
+    OB_AVX2 __m256i mullo(__m256i const lhs, __m256i const rhs)
+    {
+      auto const low = _mm256_mul_epu32(lhs, rhs);
+      auto const cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(lhs, 32), rhs),
+        _mm256_mul_epu32(lhs, _mm256_srli_epi64(rhs, 32)));
+      return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+    }
+#endif
+
+    // min and max keep lhs when the compare is false, as with nan,
+    // minpd and maxpd return their second operand in that case
+    struct Add
+    {
+      static std::int64_t scalar(std::int64_t const lhs, std::int64_t const rhs)
+      {
+        return wrap(bits(lhs) + bits(rhs));
+      }
+
+      static double scalar(double const lhs, double const rhs)
+      {
+        return lhs + rhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128i sse2(__m128i const lhs, __m128i const rhs)
+      {
+        return _mm_add_epi64(lhs, rhs);
+      }
+
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_add_pd(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256i avx2(__m256i const lhs, __m256i const rhs)
+      {
+        return _mm256_add_epi64(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_add_pd(lhs, rhs);
+      }
+#endif
+    };
+
+    struct Sub
+    {
+      static std::int64_t scalar(std::int64_t const lhs, std::int64_t const rhs)
+      {
+        return wrap(bits(lhs) - bits(rhs));
+      }
+
+      static double scalar(double const lhs, double const rhs)
+      {
+        return lhs - rhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128i sse2(__m128i const lhs, __m128i const rhs)
+      {
+        return _mm_sub_epi64(lhs, rhs);
+      }
+
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_sub_pd(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256i avx2(__m256i const lhs, __m256i const rhs)
+      {
+        return _mm256_sub_epi64(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_sub_pd(lhs, rhs);
+      }
+#endif
+    };
+
+    struct Mlt
+    {
+      static std::int64_t scalar(std::int64_t const lhs, std::int64_t const rhs)
+      {
+        return wrap(bits(lhs) * bits(rhs));
+      }
+
+      static double scalar(double const lhs, double const rhs)
+      {
+        return lhs * rhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128i sse2(__m128i const lhs, __m128i const rhs)
+      {
+        return mullo(lhs, rhs);
+      }
+
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_mul_pd(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256i avx2(__m256i const lhs, __m256i const rhs)
+      {
+        return mullo(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_mul_pd(lhs, rhs);
+      }
+#endif
+    };
+
+    struct Div
+    {
+      static double scalar(double const lhs, double const rhs)
+      {
+        return lhs / rhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_div_pd(lhs, rhs);
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_div_pd(lhs, rhs);
+      }
+#endif
+    };
+
+    struct Min
+    {
+      static std::int64_t scalar(std::int64_t const lhs, std::int64_t const rhs)
+      {
+        return rhs < lhs ? rhs : lhs;
+      }
+
+      static double scalar(double const lhs, double const rhs)
+      {
+        return rhs < lhs ? rhs : lhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_min_pd(rhs, lhs);
+      }
+
+      OB_AVX2 static __m256i avx2(__m256i const lhs, __m256i const rhs)
+      {
+        return _mm256_blendv_epi8(lhs, rhs, _mm256_cmpgt_epi64(lhs, rhs));
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_min_pd(rhs, lhs);
+      }
+#endif
+    };
+
+    struct Max
+    {
+      static std::int64_t scalar(std::int64_t const lhs, std::int64_t const rhs)
+      {
+        return lhs < rhs ? rhs : lhs;
+      }
+
+      static double scalar(double const lhs, double const rhs)
+      {
+        return lhs < rhs ? rhs : lhs;
+      }
+
+#if OB_SIMD_X86
+      static __m128d sse2(__m128d const lhs, __m128d const rhs)
+      {
+        return _mm_max_pd(rhs, lhs);
+      }
+
+      OB_AVX2 static __m256i avx2(__m256i const lhs, __m256i const rhs)
+      {
+        return _mm256_blendv_epi8(lhs, rhs, _mm256_cmpgt_epi64(rhs, lhs));
+      }
+
+      OB_AVX2 static __m256d avx2(__m256d const lhs, __m256d const rhs)
+      {
+        return _mm256_max_pd(rhs, lhs);
+      }
+#endif
+    };
+
+    template <typename Op, typename T>
+    void map_scalar(T* lhs, T const* rhs, std::size_t const n)
+    {
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        lhs[i] = Op::scalar(lhs[i], rhs[i]);
+      }
+    }
+
+#if OB_SIMD_X86
+    template <typename Op>
+    void map_sse2(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+      std::size_t i {0};
+      for (; i + 2 <= n; i += 2)
+      {
+        auto const l = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + i));
+        auto const r = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lhs + i), Op::sse2(l, r));
+      }
+      map_scalar<Op>(lhs + i, rhs + i, n - i);
+    }
+
+    template <typename Op>
+    void map_sse2(double* lhs, double const* rhs, std::size_t const n)
+    {
+      std::size_t i {0};
+      for (; i + 2 <= n; i += 2)
+      {
+        _mm_storeu_pd(lhs + i, Op::sse2(_mm_loadu_pd(lhs + i), _mm_loadu_pd(rhs + i)));
+      }
+      map_scalar<Op>(lhs + i, rhs + i, n - i);
+    }
+
+    template <typename Op>
+    OB_AVX2 void map_avx2(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        auto const l = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(lhs + i));
+        auto const r = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rhs + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lhs + i), Op::avx2(l, r));
+      }
+      map_scalar<Op>(lhs + i, rhs + i, n - i);
+    }
+
+    template <typename Op>
+    OB_AVX2 void map_avx2(double* lhs, double const* rhs, std::size_t const n)
+    {
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        _mm256_storeu_pd(lhs + i, Op::avx2(_mm256_loadu_pd(lhs + i), _mm256_loadu_pd(rhs + i)));
+      }
+      map_scalar<Op>(lhs + i, rhs + i, n - i);
+    }
+#endif
+
+    template <typename Op, typename T>
+    void map(T* lhs, T const* rhs, std::size_t const n)
+    {
+      switch (current())
+      {
+#if OB_SIMD_X86
+        case Level::avx2:
+          map_avx2<Op>(lhs, rhs, n);
+          return;
+
+        case Level::sse2:
+          map_sse2<Op>(lhs, rhs, n);
+          return;
+#endif
+
+        default:
+          map_scalar<Op>(lhs, rhs, n);
+          return;
+      }
+    }
+
+    // int min and max, sse2 has no 64 bit compare
+    template <typename Op>
+    void map_wide(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+#if OB_SIMD_X86
+      if (current() == Level::avx2)
+      {
+        map_avx2<Op>(lhs, rhs, n);
+        return;
+      }
+#endif
+      map_scalar<Op>(lhs, rhs, n);
+    }
+
+    // sums of the elements or of the products, without rhs or with it,
+    // ints wrap so their order does not matter, dbls go to four running
+    // sums by index mod 4 added as (s0 + s1) + (s2 + s3), then the rest
+    std::int64_t reduce_scalar(std::int64_t const* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+      std::uint64_t res {0};
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        res += rhs == nullptr ? bits(lhs[i]) : bits(lhs[i]) * bits(rhs[i]);
+      }
+      return wrap(res);
+    }
+
+    double reduce_scalar(double const* lhs, double const* rhs, std::size_t const n)
+    {
+      double sums[4] {0.0, 0.0, 0.0, 0.0};
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+          sums[j] += rhs == nullptr ? lhs[i + j] : lhs[i + j] * rhs[i + j];
+        }
+      }
+
+      auto res = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+      for (; i < n; ++i)
+      {
+        res += rhs == nullptr ? lhs[i] : lhs[i] * rhs[i];
+      }
+      return res;
+    }
+
+#if OB_SIMD_X86
+    std::int64_t reduce_sse2(std::int64_t const* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+      auto acc = _mm_setzero_si128();
+      std::size_t i {0};
+      for (; i + 2 <= n; i += 2)
+      {
+        auto val = _mm_loadu_si128(reinterpret_cast<__m128i const*>(lhs + i));
+        if (rhs != nullptr)
+        {
+          val = mullo(val, _mm_loadu_si128(reinterpret_cast<__m128i const*>(rhs + i)));
+        }
+        acc = _mm_add_epi64(acc, val);
+      }
+
+      std::int64_t lanes[2];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+      auto const rest = reduce_scalar(lhs + i, rhs == nullptr ? nullptr : rhs + i, n - i);
+      return wrap(bits(lanes[0]) + bits(lanes[1]) + bits(rest));
+    }
+
+    double reduce_sse2(double const* lhs, double const* rhs, std::size_t const n)
+    {
+      // lanes 0 and 1, then 2 and 3
+      auto low = _mm_setzero_pd();
+      auto high = _mm_setzero_pd();
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        auto l = _mm_loadu_pd(lhs + i);
+        auto h = _mm_loadu_pd(lhs + i + 2);
+        if (rhs != nullptr)
+        {
+          l = _mm_mul_pd(l, _mm_loadu_pd(rhs + i));
+          h = _mm_mul_pd(h, _mm_loadu_pd(rhs + i + 2));
+        }
+        low = _mm_add_pd(low, l);
+        high = _mm_add_pd(high, h);
+      }
+
+      double sums[4];
+      _mm_storeu_pd(sums, low);
+      _mm_storeu_pd(sums + 2, high);
+      auto res = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+      for (; i < n; ++i)
+      {
+        res += rhs == nullptr ? lhs[i] : lhs[i] * rhs[i];
+      }
+      return res;
+    }
+
+    OB_AVX2 std::int64_t reduce_avx2(std::int64_t const* lhs, std::int64_t const* rhs, std::size_t const n)
+    {
+      auto acc = _mm256_setzero_si256();
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        auto val = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(lhs + i));
+        if (rhs != nullptr)
+        {
+          val = mullo(val, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(rhs + i)));
+        }
+        acc = _mm256_add_epi64(acc, val);
+      }
+
+      std::int64_t lanes[4];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+      auto const rest = reduce_scalar(lhs + i, rhs == nullptr ? nullptr : rhs + i, n - i);
+      return wrap(bits(lanes[0]) + bits(lanes[1]) + bits(lanes[2]) + bits(lanes[3]) + bits(rest));
+    }
+
+    OB_AVX2 double reduce_avx2(double const* lhs, double const* rhs, std::size_t const n)
+    {
+      auto acc = _mm256_setzero_pd();
+      std::size_t i {0};
+      for (; i + 4 <= n; i += 4)
+      {
+        auto val = _mm256_loadu_pd(lhs + i);
+        if (rhs != nullptr)
+        {
+          val = _mm256_mul_pd(val, _mm256_loadu_pd(rhs + i));
+        }
+        acc = _mm256_add_pd(acc, val);
+      }
+
+      double sums[4];
+      _mm256_storeu_pd(sums, acc);
+      auto res = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+      for (; i < n; ++i)
+      {
+        res += rhs == nullptr ? lhs[i] : lhs[i] * rhs[i];
+      }
+      return res;
+    }
+#endif
+
+    template <typename T>
+    T reduce(T const* lhs, T const* rhs, std::size_t const n)
+    {
+      switch (current())
+      {
+#if OB_SIMD_X86
+        case Level::avx2:
+          return reduce_avx2(lhs, rhs, n);
+
+        case Level::sse2:
+          return reduce_sse2(lhs, rhs, n);
+#endif
+
+        default:
+          return reduce_scalar(lhs, rhs, n);
+      }
+    }
+  } // namespace
+
+  char const* level()
+  {
+    switch (current())
+    {
+      case Level::avx2:
+        return "avx2";
+
+      case Level::sse2:
+        return "sse2";
+
+      default:
+        return "scalar";
+    }
+  }
+
+  void add(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    map<Add>(lhs, rhs, n);
+  }
+
+  void sub(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    map<Sub>(lhs, rhs, n);
+  }
+
+  void mlt(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    map<Mlt>(lhs, rhs, n);
+  }
+
+  void min(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    map_wide<Min>(lhs, rhs, n);
+  }
+
+  void max(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    map_wide<Max>(lhs, rhs, n);
+  }
+
+  void add(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Add>(lhs, rhs, n);
+  }
+
+  void sub(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Sub>(lhs, rhs, n);
+  }
+
+  void mlt(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Mlt>(lhs, rhs, n);
+  }
+
+  void div(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Div>(lhs, rhs, n);
+  }
+
+  void min(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Min>(lhs, rhs, n);
+  }
+
+  void max(double* lhs, double const* rhs, std::size_t const n)
+  {
+    map<Max>(lhs, rhs, n);
+  }
+
+  std::int64_t sum(std::int64_t const* val, std::size_t const n)
+  {
+    return reduce<std::int64_t>(val, nullptr, n);
+  }
+
+  std::int64_t dot(std::int64_t const* lhs, std::int64_t const* rhs, std::size_t const n)
+  {
+    return reduce(lhs, rhs, n);
+  }
+
+  double sum(double const* val, std::size_t const n)
+  {
+    return reduce<double>(val, nullptr, n);
+  }
+
+  double dot(double const* lhs, double const* rhs, std::size_t const n)
+  {
+    return reduce(lhs, rhs, n);
+  }
+} // namespace Simd
+
+} // namespace OB
@@ -0,0 +1,41 @@
+#ifndef OB_SIMD_HH
+#define OB_SIMD_HH
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+// element-wise kernels over arrays of n elements, the widest the cpu
+// runs is picked on first use, avx2, sse2 or plain loops,
+// PINE_SIMD in the environment can name a narrower one
+namespace Simd
+{
+  // 'avx2', 'sse2' or 'scalar'
+  char const* level();
+
+  // lhs[i] = lhs[i] op rhs[i], ints wrap around on overflow
+  void add(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n);
+  void sub(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n);
+  void mlt(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n);
+  void min(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n);
+  void max(std::int64_t* lhs, std::int64_t const* rhs, std::size_t const n);
+
+  void add(double* lhs, double const* rhs, std::size_t const n);
+  void sub(double* lhs, double const* rhs, std::size_t const n);
+  void mlt(double* lhs, double const* rhs, std::size_t const n);
+  void div(double* lhs, double const* rhs, std::size_t const n);
+  void min(double* lhs, double const* rhs, std::size_t const n);
+  void max(double* lhs, double const* rhs, std::size_t const n);
+
+  // sum of the elements and of their products, dbls are added in four
+  // running sums so every level gives the same result
+  std::int64_t sum(std::int64_t const* val, std::size_t const n);
+  std::int64_t dot(std::int64_t const* lhs, std::int64_t const* rhs, std::size_t const n);
+  double sum(double const* val, std::size_t const n);
+  double dot(double const* lhs, double const* rhs, std::size_t const n);
+} // namespace Simd
+
+} // namespace OB
+
+#endif // OB_SIMD_HH
@@ -0,0 +1,180 @@
+#include "trace.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace OB
+{
+  namespace
+  {
+    // records per chunk and chunks in the ring
+    constexpr std::size_t chunk_records {1 << 14};
+    constexpr std::size_t chunk_count {8};
+  } // namespace
+
+  Tracer::Tracer(std::string const& file, std::vector<std::string> opcodes) :
+    fd_ {::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)},
+    start_ {std::chrono::steady_clock::now()},
+    opcodes_ {std::move(opcodes)}
+  {
+    if (fd_ < 0)
+    {
+      return;
+    }
+
+    Trace::Header header;
+    std::memcpy(header.magic, Trace::magic, sizeof(header.magic));
+    header.version = Trace::version;
+    header.record_size = sizeof(Trace::Record);
+    if (! write_all(&header, sizeof(header)))
+    {
+      ::close(fd_);
+      fd_ = -1;
+      return;
+    }
+
+    chunks_.resize(chunk_count, Chunk(chunk_records));
+    for (auto& e : chunks_)
+    {
+      free_.emplace_back(&e);
+    }
+    chunk_ = free_.back();
+    free_.pop_back();
+
+    thread_ = std::thread([this] { writer(); });
+  }
+
+  Tracer::~Tracer()
+  {
+    if (fd_ < 0)
+    {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock {mtx_};
+      if (size_ > 0)
+      {
+        full_.emplace_back(chunk_, size_);
+        records_ += size_;
+      }
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+
+    // tables and footer go after the records
+    auto const offset = ::lseek(fd_, 0, SEEK_CUR);
+    auto const table = [&](std::vector<std::string> const& names)
+    {
+      for (auto const& e : names)
+      {
+        auto const len = static_cast<std::uint32_t>(e.size());
+        write_all(&len, sizeof(len));
+        write_all(e.data(), e.size());
+      }
+    };
+
+    std::vector<std::string> symbols(symbols_.size());
+    for (auto const& e : symbols_)
+    {
+      symbols.at(e.second) = e.first;
+    }
+    table(symbols);
+    table(opcodes_);
+
+    Trace::Footer footer;
+    footer.records = records_;
+    footer.tables = static_cast<std::uint64_t>(offset);
+    footer.symbols = static_cast<std::uint32_t>(symbols.size());
+    footer.opcodes = static_cast<std::uint32_t>(opcodes_.size());
+    std::memcpy(footer.magic, Trace::magic, sizeof(footer.magic));
+    write_all(&footer, sizeof(footer));
+
+    ::close(fd_);
+  }
+
+  bool Tracer::is_open() const
+  {
+    return fd_ >= 0;
+  }
+
+  std::uint32_t Tracer::symbol(std::string const& name)
+  {
+    auto const it = symbols_.find(name);
+    if (it != symbols_.end())
+    {
+      return it->second;
+    }
+
+    auto const id = static_cast<std::uint32_t>(symbols_.size());
+    symbols_.emplace(name, id);
+
+    return id;
+  }
+
+  void Tracer::swap()
+  {
+    std::unique_lock<std::mutex> lock {mtx_};
+    full_.emplace_back(chunk_, size_);
+    records_ += size_;
+    cv_.notify_one();
+
+    // the interpreter waits when the writer falls a whole ring behind
+    cv_free_.wait(lock, [&] { return ! free_.empty(); });
+    chunk_ = free_.back();
+    free_.pop_back();
+    size_ = 0;
+  }
+
+  void Tracer::writer()
+  {
+    for (;;)
+    {
+      std::pair<Chunk*, std::size_t> chunk;
+      {
+        std::unique_lock<std::mutex> lock {mtx_};
+        cv_.wait(lock, [&] { return stop_ || ! full_.empty(); });
+        if (full_.empty())
+        {
+          return;
+        }
+        chunk = full_.front();
+        full_.pop_front();
+      }
+
+      write_all(chunk.first->data(), chunk.second * sizeof(Trace::Record));
+
+      {
+        std::lock_guard<std::mutex> lock {mtx_};
+        free_.emplace_back(chunk.first);
+      }
+      cv_free_.notify_one();
+    }
+  }
+
+  bool Tracer::write_all(void const* data, std::size_t size)
+  {
+    auto ptr = static_cast<char const*>(data);
+    while (size > 0)
+    {
+      auto const n = ::write(fd_, ptr, size);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return false;
+      }
+      ptr += n;
+      size -= static_cast<std::size_t>(n);
+    }
+
+    return true;
+  }
+} // namespace OB
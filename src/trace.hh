@@ -0,0 +1,132 @@
+#ifndef OB_TRACE_HH
+#define OB_TRACE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <string>
+
+namespace OB
+{
+// binary trace file layout
+//   Header
+//   Record * n
+//   symbol and opcode tables, each entry a uint32 length then the bytes
+//   Footer
+namespace Trace
+{
+  constexpr char magic[8] {'P', 'I', 'N', 'E', 'T', 'R', 'C', '1'};
+  constexpr std::uint32_t version {1};
+
+  // operand slot of an instruction without that operand
+  constexpr std::uint32_t none {0xffffffff};
+
+  struct Header
+  {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+  };
+
+  struct Record
+  {
+    // ns since the start of the trace
+    std::uint64_t ns;
+    // source line
+    std::uint32_t pc;
+    // operand slots, indices into the symbol table
+    std::uint32_t a;
+    std::uint32_t b;
+    // index into the opcode table
+    std::uint16_t op;
+    // cmp flag after the instruction ran
+    std::int8_t cmp;
+    std::uint8_t pad;
+  };
+
+  struct Footer
+  {
+    std::uint64_t records;
+    std::uint64_t tables;
+    std::uint32_t symbols;
+    std::uint32_t opcodes;
+    char magic[8];
+  };
+} // namespace Trace
+
+class Tracer
+{
+public:
+  Tracer(std::string const& file, std::vector<std::string> opcodes);
+
+  // flushes the remaining records and writes the tables
+  ~Tracer();
+
+  Tracer(Tracer const&) = delete;
+  Tracer& operator=(Tracer const&) = delete;
+
+  bool is_open() const;
+
+  // index of a name in the symbol table
+  std::uint32_t symbol(std::string const& name);
+
+  std::uint64_t now() const
+  {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start_).count());
+  }
+
+  void record(std::uint64_t ns, std::uint32_t pc, std::uint16_t op,
+    std::uint32_t a, std::uint32_t b, int cmp)
+  {
+    auto& e = chunk_->at(size_);
+    e.ns = ns;
+    e.pc = pc;
+    e.a = a;
+    e.b = b;
+    e.op = op;
+    e.cmp = static_cast<std::int8_t>(cmp < 0 ? -1 : (cmp > 0 ? 1 : 0));
+    e.pad = 0;
+
+    if (++size_ == chunk_->size())
+    {
+      swap();
+    }
+  }
+
+private:
+  using Chunk = std::vector<Trace::Record>;
+
+  // hands the full chunk to the writer thread and takes a free one
+  void swap();
+  void writer();
+  bool write_all(void const* data, std::size_t size);
+
+  int fd_ {-1};
+  std::chrono::steady_clock::time_point start_;
+  std::vector<std::string> opcodes_;
+  std::map<std::string, std::uint32_t> symbols_;
+
+  Chunk* chunk_ {nullptr};
+  std::size_t size_ {0};
+  std::uint64_t records_ {0};
+
+  std::vector<Chunk> chunks_;
+  std::deque<std::pair<Chunk*, std::size_t>> full_;
+  std::vector<Chunk*> free_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::condition_variable cv_free_;
+  bool stop_ {false};
+  std::thread thread_;
+}; // class Tracer
+
+} // namespace OB
+
+#endif // OB_TRACE_HH
@@ -0,0 +1,255 @@
+#include "parg.hh"
+using Parg = OB::Parg;
+
+#include "trace.hh"
+namespace Trace = OB::Trace;
+
+#define FMT_HEADER_ONLY
+#include "format.h"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <iostream>
+
+int program_options(Parg& pg);
+bool read_table(std::ifstream& ifile, std::uint32_t count, std::vector<std::string>& names);
+std::string escape(std::string const& str);
+
+int program_options(Parg& pg)
+{
+  pg.name("pine-trace").version("0.2.0");
+  pg.description("decodes a binary trace written by pine --trace");
+  pg.usage("[flags] [options]");
+  pg.usage("[-v|--version]");
+  pg.usage("[-h|--help]");
+  pg.info("Exit Codes", {"0 -> normal", "1 -> error"});
+  pg.author("octobanana (Brett Robinson) <octobanana.dev@gmail.com>");
+
+  pg.set("help,h", "print the help output");
+  pg.set("version,v", "print the program version");
+  pg.set("file,f", "", "file_name", "trace file to read from");
+  pg.set("format", "text", "format", "output format, 'text' or 'chrome' trace event json");
+  pg.set("output,o", "", "file_name", "write to a file instead of stdout");
+
+  int status {pg.parse()};
+  if (status < 0)
+  {
+    std::cout << pg.print_help() << "\n";
+    std::cout << "Error: " << pg.error() << "\n";
+    return -1;
+  }
+  if (pg.get<bool>("help"))
+  {
+    std::cout << pg.print_help();
+    return 1;
+  }
+  if (pg.get<bool>("version"))
+  {
+    std::cout << pg.print_version();
+    return 1;
+  }
+  return 0;
+}
+
+bool read_table(std::ifstream& ifile, std::uint32_t count, std::vector<std::string>& names)
+{
+  for (std::uint32_t i = 0; i < count; ++i)
+  {
+    std::uint32_t len {0};
+    if (! ifile.read(reinterpret_cast<char*>(&len), sizeof(len)))
+    {
+      return false;
+    }
+    std::string name(len, '\0');
+    if (len > 0 && ! ifile.read(&name[0], len))
+    {
+      return false;
+    }
+    names.emplace_back(std::move(name));
+  }
+
+  return true;
+}
+
+std::string escape(std::string const& str)
+{
+  std::string out;
+  for (auto const c : str)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      out += fmt::format("\\u{:04x}", static_cast<int>(c));
+    }
+    else
+    {
+      out += c;
+    }
+  }
+  return out;
+}
+
+int main(int argc, char *argv[])
+{
+  Parg pg {argc, argv};
+  int pstatus {program_options(pg)};
+  if (pstatus > 0) return 0;
+  else if (pstatus < 0) return 1;
+
+  if (! pg.find("file"))
+  {
+    // error
+    std::cerr << "Error: missing file argument\n";
+    return 1;
+  }
+
+  std::string const format {pg.get("format")};
+  if (format != "text" && format != "chrome")
+  {
+    // error
+    std::cerr << "Error: format must be either 'text' or 'chrome'\n";
+    return 1;
+  }
+
+  std::ifstream ifile {pg.get("file"), std::ios::binary};
+  if (! ifile.is_open())
+  {
+    // error
+    std::cerr << "Error: could not open file\n";
+    return 1;
+  }
+
+  Trace::Header header;
+  if (! ifile.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+    std::memcmp(header.magic, Trace::magic, sizeof(header.magic)) != 0 ||
+    header.version != Trace::version || header.record_size != sizeof(Trace::Record))
+  {
+    // error
+    std::cerr << "Error: not a pine trace file\n";
+    return 1;
+  }
+
+  Trace::Footer footer;
+  ifile.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+  if (! ifile.read(reinterpret_cast<char*>(&footer), sizeof(footer)) ||
+    std::memcmp(footer.magic, Trace::magic, sizeof(footer.magic)) != 0)
+  {
+    // error
+    std::cerr << "Error: trace file is incomplete\n";
+    return 1;
+  }
+
+  std::vector<std::string> symbols;
+  std::vector<std::string> opcodes;
+  ifile.seekg(static_cast<std::streamoff>(footer.tables));
+  if (! read_table(ifile, footer.symbols, symbols) || ! read_table(ifile, footer.opcodes, opcodes))
+  {
+    // error
+    std::cerr << "Error: trace file is corrupt\n";
+    return 1;
+  }
+
+  std::vector<Trace::Record> records(footer.records);
+  ifile.seekg(static_cast<std::streamoff>(sizeof(header)));
+  if (! records.empty() && ! ifile.read(reinterpret_cast<char*>(records.data()),
+    static_cast<std::streamsize>(records.size() * sizeof(Trace::Record))))
+  {
+    // error
+    std::cerr << "Error: trace file is corrupt\n";
+    return 1;
+  }
+
+  std::FILE* out {stdout};
+  if (pg.find("output"))
+  {
+    out = std::fopen(pg.get("output").c_str(), "w");
+    if (out == nullptr)
+    {
+      // error
+      std::cerr << "Error: could not open output file\n";
+      return 1;
+    }
+  }
+
+  auto const symbol = [&](std::uint32_t id) -> std::string
+  {
+    if (id == Trace::none)
+    {
+      return "";
+    }
+    if (id < symbols.size())
+    {
+      return symbols.at(id);
+    }
+    return fmt::format("${}", id);
+  };
+
+  auto const opcode = [&](std::uint16_t id) -> std::string
+  {
+    if (id < opcodes.size())
+    {
+      return opcodes.at(id);
+    }
+    return fmt::format("op{}", id);
+  };
+
+  if (format == "text")
+  {
+    for (auto const& e : records)
+    {
+      fmt::print(out, "{:>14} [{}]: {} {} {}  cmp {}\n", e.ns, e.pc, opcode(e.op),
+        symbol(e.a), symbol(e.b), static_cast<int>(e.cmp));
+    }
+  }
+  else
+  {
+    // instructions are complete events, run and ret open and close a span per call
+    fmt::print(out, "{{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    bool first {true};
+    auto const event = [&](std::string const& str)
+    {
+      fmt::print(out, "{}  {}", first ? "" : ",\n", str);
+      first = false;
+    };
+
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+      auto const& e = records.at(i);
+      auto const end = i + 1 < records.size() ? records.at(i + 1).ns : e.ns;
+      auto const name = opcode(e.op);
+
+      if (name == "run")
+      {
+        event(fmt::format("{{\"name\": \"{}\", \"cat\": \"run\", \"ph\": \"B\", \"ts\": {:.3f}, \"pid\": 1, \"tid\": 1}}",
+          escape(symbol(e.a)), static_cast<double>(e.ns) / 1e3));
+      }
+
+      event(fmt::format("{{\"name\": \"{}\", \"cat\": \"ins\", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, \"pid\": 1, \"tid\": 1, "
+        "\"args\": {{\"pc\": {}, \"a\": \"{}\", \"b\": \"{}\", \"cmp\": {}}}}}",
+        name, static_cast<double>(e.ns) / 1e3, static_cast<double>(end - e.ns) / 1e3,
+        e.pc, escape(symbol(e.a)), escape(symbol(e.b)), static_cast<int>(e.cmp)));
+
+      if (name == "ret")
+      {
+        event(fmt::format("{{\"ph\": \"E\", \"ts\": {:.3f}, \"pid\": 1, \"tid\": 1}}",
+          static_cast<double>(end) / 1e3));
+      }
+    }
+    fmt::print(out, "\n]}}\n");
+  }
+
+  if (out != stdout)
+  {
+    std::fclose(out);
+  }
+
+  return 0;
+}
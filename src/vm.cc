@@ -0,0 +1,247 @@
+#include "vm.hh"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace OB
+{
+  constexpr std::size_t Vm::none;
+
+  namespace
+  {
+    // instructions with an op of their own
+    std::map<std::string, Vm::Code> const& codes()
+    {
+      static std::map<std::string, Vm::Code> const map {
+        {"mov", Vm::Code::mov},
+        {"clr", Vm::Code::clr},
+        {"add", Vm::Code::add},
+        {"sub", Vm::Code::sub},
+        {"mlt", Vm::Code::mlt},
+        {"div", Vm::Code::div},
+        {"mod", Vm::Code::mod},
+        {"cmp", Vm::Code::cmp},
+        {"lbl", Vm::Code::lbl},
+        {"jmp", Vm::Code::jmp},
+        {"jeq", Vm::Code::jeq},
+        {"jne", Vm::Code::jne},
+        {"jlt", Vm::Code::jlt},
+        {"jgt", Vm::Code::jgt},
+        {"jge", Vm::Code::jge},
+        {"jle", Vm::Code::jle},
+        {"itr", Vm::Code::itr},
+        {"psh", Vm::Code::psh},
+        {"pop", Vm::Code::pop},
+        {"prt", Vm::Code::prt},
+        {"ask", Vm::Code::ask},
+        {"run", Vm::Code::run},
+        {"ret", Vm::Code::ret},
+        {"ext", Vm::Code::ext},
+      };
+      return map;
+    }
+
+    // the jump an itr condition stands for
+    std::map<std::string, Vm::Code> const& conditions()
+    {
+      static std::map<std::string, Vm::Code> const map {
+        {"eq", Vm::Code::jeq},
+        {"ne", Vm::Code::jne},
+        {"lt", Vm::Code::jlt},
+        {"gt", Vm::Code::jgt},
+        {"ge", Vm::Code::jge},
+        {"le", Vm::Code::jle},
+      };
+      return map;
+    }
+  } // namespace
+
+  Vm::Vm(Optimizer::Program program) :
+    program_ {std::move(program)}
+  {
+    std::map<std::string, std::uint32_t> regs;
+    auto const reg = [&](std::string const& name)
+    {
+      auto const it = regs.find(name);
+      if (it != regs.end())
+      {
+        return it->second;
+      }
+      auto const index = static_cast<std::uint32_t>(names_.size());
+      regs.emplace(name, index);
+      names_.emplace_back(name);
+      return index;
+    };
+
+    std::map<std::string, std::uint32_t> labels;
+    auto const label = [&](std::string const& name)
+    {
+      auto const it = labels.find(name);
+      if (it != labels.end())
+      {
+        return it->second;
+      }
+      auto const index = static_cast<std::uint32_t>(labels_.size());
+      labels.emplace(name, index);
+      labels_.emplace_back(Label {name, none});
+      return index;
+    };
+
+    for (auto const& e : program_)
+    {
+      if (! e.is_ins())
+      {
+        continue;
+      }
+
+      if (e.op() == "dbg")
+      {
+        return;
+      }
+
+      auto const it = codes().find(e.op());
+
+      Op op;
+      op.code = it == codes().end() ? Code::ins : it->second;
+      op.line = e.line;
+
+      switch (op.code)
+      {
+        case Code::mov:
+        {
+          op.a = reg(e.args.at(1));
+          op.b = static_cast<std::uint32_t>(literals_.size());
+          literals_.emplace_back(e.args.at(2));
+          break;
+        }
+
+        case Code::add:
+        case Code::sub:
+        case Code::mlt:
+        case Code::div:
+        case Code::mod:
+        case Code::cmp:
+        {
+          op.a = reg(e.args.at(1));
+          op.b = reg(e.args.at(2));
+          break;
+        }
+
+        case Code::lbl:
+        {
+          op.label = label(e.args.at(1));
+
+          // a second declaration is an error at runtime
+          auto& decl = labels_.at(op.label);
+          if (decl.op != none)
+          {
+            return;
+          }
+          decl.op = code_.size();
+          break;
+        }
+
+        case Code::jmp:
+        case Code::jeq:
+        case Code::jne:
+        case Code::jlt:
+        case Code::jgt:
+        case Code::jge:
+        case Code::jle:
+        case Code::run:
+        {
+          op.label = label(e.args.at(1));
+          break;
+        }
+
+        case Code::itr:
+        {
+          op.cond = conditions().at(e.args.at(1));
+          op.a = reg(e.args.at(2));
+          op.b = reg(e.args.at(3));
+          op.c = reg(e.args.at(4));
+          op.label = label(e.args.at(5));
+          break;
+        }
+
+        case Code::ret:
+        {
+          break;
+        }
+
+        case Code::ins:
+        {
+          Call call;
+          call.name = e.op();
+          for (std::size_t i = 1; i < e.args.size(); ++i)
+          {
+            // an optional operand that was left out is empty
+            if (e.args.at(i).empty())
+            {
+              continue;
+            }
+            auto const r = reg(e.args.at(i));
+            if (std::find(call.regs.begin(), call.regs.end(), r) == call.regs.end())
+            {
+              call.regs.emplace_back(r);
+            }
+          }
+          op.a = static_cast<std::uint32_t>(calls_.size());
+          calls_.emplace_back(std::move(call));
+          break;
+        }
+
+        default:
+        {
+          op.a = reg(e.args.at(1));
+          break;
+        }
+      }
+
+      code_.emplace_back(op);
+    }
+
+    ok_ = true;
+  }
+
+  bool Vm::ok() const
+  {
+    return ok_;
+  }
+
+  std::vector<Vm::Op> const& Vm::code() const
+  {
+    return code_;
+  }
+
+  std::vector<Vm::Label> const& Vm::labels() const
+  {
+    return labels_;
+  }
+
+  std::vector<Vm::Call> const& Vm::calls() const
+  {
+    return calls_;
+  }
+
+  std::vector<std::string> const& Vm::names() const
+  {
+    return names_;
+  }
+
+  std::vector<std::string> const& Vm::literals() const
+  {
+    return literals_;
+  }
+
+  std::string const& Vm::text(int const line) const
+  {
+    return program_.at(static_cast<std::size_t>(line - 1)).text;
+  }
+
+  int Vm::lines() const
+  {
+    return static_cast<int>(program_.size());
+  }
+} // namespace OB
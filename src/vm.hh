@@ -0,0 +1,124 @@
+#ifndef OB_VM_HH
+#define OB_VM_HH
+
+#include "opt.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <string>
+
+namespace OB
+{
+// compiles a program to register code, each variable name is a register
+// and a run frame resets the ones it made when it returns, so the core
+// instructions reach their operands by index instead of looking up their
+// names, the others are called with their operands as the interpreter
+// would call them
+class Vm
+{
+public:
+  enum class Code : std::uint8_t
+  {
+    mov,
+    clr,
+    add,
+    sub,
+    mlt,
+    div,
+    mod,
+    cmp,
+    lbl,
+    jmp,
+    jeq,
+    jne,
+    jlt,
+    jgt,
+    jge,
+    jle,
+    itr,
+    psh,
+    pop,
+    prt,
+    ask,
+    run,
+    ret,
+    ext,
+
+    // any other instruction, a is the index of its call
+    ins,
+  };
+
+  // one instruction with its operands resolved, a, b and c are
+  // registers in the order the instruction names them, except that
+  // b of a mov is the literal, label is an index into labels
+  struct Op
+  {
+    Code code {Code::lbl};
+
+    // jump an itr takes on its condition
+    Code cond {Code::jmp};
+
+    std::uint32_t a {0};
+    std::uint32_t b {0};
+    std::uint32_t c {0};
+    std::uint32_t label {0};
+
+    // line of the program the op came from
+    int line {0};
+  };
+
+  static constexpr std::size_t none {std::numeric_limits<std::size_t>::max()};
+
+  struct Label
+  {
+    std::string name;
+
+    // op of the lbl, none when no line declares it
+    std::size_t op {none};
+  };
+
+  // registers named by an instruction without an op of its own,
+  // each one once
+  struct Call
+  {
+    std::string name;
+    std::vector<std::uint32_t> regs;
+  };
+
+  // program as it runs, one entry for each line
+  explicit Vm(Optimizer::Program program);
+
+  // false when the program uses dbg, whose output shows the
+  // interpreter's state, or declares a label twice
+  bool ok() const;
+
+  std::vector<Op> const& code() const;
+  std::vector<Label> const& labels() const;
+  std::vector<Call> const& calls() const;
+
+  // name of each register and the text of each literal
+  std::vector<std::string> const& names() const;
+  std::vector<std::string> const& literals() const;
+
+  // text of a line for error messages
+  std::string const& text(int const line) const;
+
+  // number of lines, a jump on the last one never happens
+  int lines() const;
+
+private:
+  Optimizer::Program program_;
+  bool ok_ {false};
+
+  std::vector<Op> code_;
+  std::vector<Label> labels_;
+  std::vector<Call> calls_;
+  std::vector<std::string> names_;
+  std::vector<std::string> literals_;
+}; // class Vm
+
+} // namespace OB
+
+#endif // OB_VM_HH